@@ -0,0 +1,252 @@
+//
+//  Accuracy.cpp
+//  wunderwelt-vamp-plugin
+//
+//  Runs synthetic pass-bys with known speeds (see DopplerScene) through the speed calculator with a few parameter
+//  presets and prints the distribution of the speed errors next to the throughput of each preset. The grid of scenes
+//  covers several speeds, distances, fundamentals and noise levels; a scene counts as missed if no speed is returned.
+//  The throughput only includes the time spent in the plugin, not the FFT done by the host for the frequency domain.
+//
+
+#include "DopplerScene.hpp"
+#include "DopplerSpeedCalculator.hpp"
+#include "TimeDomainDopplerSpeedCalculator.hpp"
+
+#include <vamp-sdk/FFT.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+# define ACCURACY_SAMPLE_RATE 44100.0f
+# define ACCURACY_DURATION 8.0 // s
+# define ACCURACY_HARMONICS 3
+
+namespace {
+
+    struct Preset {
+        string name;
+        bool timeDomain;
+        std::map<string, float> parameters;
+    };
+
+    // the results of a preset over all scenes
+    struct Statistics {
+        vector<double> errors; // km/h, returned minus true speed of the detected scenes
+        size_t scenes = 0;
+        size_t samples = 0;
+        std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration(0);
+    };
+
+    vector<Preset> presets() {
+        return {
+            {"default", false, {}},
+            {"interpolated", false, {{PEAK_INTERPOLATION_ID, QUADRATIC_LOG_INTERPOLATION}}},
+            {"assignment", false, {{PEAK_INTERPOLATION_ID, QUADRATIC_LOG_INTERPOLATION}, {TRACING_MODE_ID, ASSIGNMENT_TRACING}}},
+            {"td-padding-4x", true, {{PEAK_INTERPOLATION_ID, QUADRATIC_LOG_INTERPOLATION}, {ZERO_PADDING_ID, 2}}},
+            {"td-zoom-4x", true, {{PEAK_INTERPOLATION_ID, QUADRATIC_LOG_INTERPOLATION}, {ZOOM_ID, 2}}},
+        };
+    }
+
+    vector<DopplerScene::Scene> scenes(bool quick) {
+        vector<double> speeds = quick ? vector<double>{50, 90} : vector<double>{30, 50, 70, 90, 110, 130};
+        vector<double> distances = quick ? vector<double>{7.5} : vector<double>{3, 7.5, 15};
+        vector<double> frequencies = quick ? vector<double>{400} : vector<double>{150, 400};
+        vector<double> signalToNoiseRatios = quick ? vector<double>{20} : vector<double>{20, 0};
+
+        vector<DopplerScene::Scene> list;
+        for (double speed : speeds) {
+            for (double distance : distances) {
+                for (double frequency : frequencies) {
+                    for (double signalToNoiseRatio : signalToNoiseRatios) {
+                        DopplerScene::Scene scene;
+                        scene.sampleRate = ACCURACY_SAMPLE_RATE;
+                        scene.duration = ACCURACY_DURATION;
+                        scene.speed = speed;
+                        scene.distance = distance;
+                        scene.frequency = frequency;
+                        scene.harmonics = ACCURACY_HARMONICS;
+                        scene.signalToNoiseRatio = signalToNoiseRatio;
+                        scene.seed = (unsigned int) list.size() + 1;
+                        list.push_back(scene);
+                    }
+                }
+            }
+        }
+        return list;
+    }
+
+    // the Hann windowed spectra of the blocks (blockSize + 2 interleaved values each), like a host calculates them
+    vector<vector<float>> spectra(const vector<float> & signal, size_t stepSize, size_t blockSize) {
+        Vamp::FFTReal fft((int) blockSize);
+        vector<double> input(blockSize), output(blockSize + 2);
+        vector<vector<float>> list;
+        for (size_t start = 0; start < signal.size() - blockSize; start += stepSize) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                input[i] = signal[start + i] * (0.5 - 0.5 * cos(2 * M_PI * i / blockSize));
+            }
+            fft.forward(input.data(), output.data());
+            list.push_back(vector<float>(output.begin(), output.end()));
+        }
+        return list;
+    }
+
+    // analyses the signal (followed by blockSize zeros) and returns the speeds, the time spent in the plugin is added
+    vector<float> analyse(const Preset & preset, const std::map<string, float> & overrides, const vector<float> & signal,
+                          Statistics & statistics) {
+        std::unique_ptr<DopplerSpeedCalculator> calculator(preset.timeDomain ?
+            new TimeDomainDopplerSpeedCalculator(ACCURACY_SAMPLE_RATE) : new DopplerSpeedCalculator(ACCURACY_SAMPLE_RATE));
+        for (auto& parameter : preset.parameters) {
+            calculator->setParameter(parameter.first, parameter.second);
+        }
+        for (auto& parameter : overrides) {
+            calculator->setParameter(parameter.first, parameter.second);
+        }
+        size_t stepSize = calculator->getPreferredStepSize();
+        size_t blockSize = calculator->getPreferredBlockSize();
+
+        int speedOutput = -1;
+        DopplerSpeedCalculator::OutputList outputs = calculator->getOutputDescriptors();
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            if (outputs[i].identifier == "naive-speed-of-source") {
+                speedOutput = (int) i;
+            }
+        }
+        vector<vector<float>> blocks;
+        if (!preset.timeDomain) {
+            blocks = spectra(signal, stepSize, blockSize);
+        }
+
+        vector<float> speeds;
+        auto collect = [&speeds, speedOutput](const DopplerSpeedCalculator::FeatureSet & features) {
+            auto it = features.find(speedOutput);
+            if (it != features.end()) {
+                for (auto& feature : it->second) {
+                    speeds.push_back(feature.values[0]);
+                }
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        if (!calculator->initialise(1, stepSize, blockSize)) {
+            std::cout << "# ERROR: can't initialise " << preset.name << "\n";
+            return speeds;
+        }
+        size_t steps = preset.timeDomain ? (signal.size() - blockSize + stepSize - 1) / stepSize : blocks.size();
+        for (size_t step = 0; step < steps; ++step) {
+            const float *input = preset.timeDomain ? signal.data() + step * stepSize : blocks[step].data();
+            collect(calculator->process(&input, RealTime::frame2RealTime(step * stepSize, (unsigned int) ACCURACY_SAMPLE_RATE)));
+        }
+        collect(calculator->getRemainingFeatures());
+        statistics.time += std::chrono::steady_clock::now() - start;
+        statistics.samples += signal.size() - blockSize;
+        return speeds;
+    }
+
+    // the smallest of the sorted values which at least the given part of them is not larger than (nearest rank)
+    double quantile(const vector<double> & sorted, double part) {
+        return sorted.empty() ? NAN : sorted[std::max<size_t>((size_t) ceil(part * sorted.size()), 1) - 1];
+    }
+
+    void report(const Preset & preset, const Statistics & statistics) {
+        vector<double> absolute;
+        double sum = 0, squares = 0;
+        for (double error : statistics.errors) {
+            absolute.push_back(fabs(error));
+            sum += error;
+            squares += error * error;
+        }
+        std::sort(absolute.begin(), absolute.end());
+        double detected = statistics.errors.size();
+        double seconds = std::chrono::duration<double>(statistics.time).count();
+
+        std::cout << preset.name << ";" << statistics.scenes << ";" << statistics.errors.size() << ";"
+                  << sum / detected << ";" << sqrt(squares / detected) << ";" << quantile(absolute, 0.5) << ";"
+                  << quantile(absolute, 0.9) << ";" << (absolute.empty() ? NAN : absolute.back()) << ";"
+                  << statistics.samples / seconds << std::endl;
+    }
+
+    void printUsage() {
+        std::cerr << "usage: wunderwelt-accuracy [-q] [-v] [-p preset] [<parameter>=<value>]...\n"
+                     "  -q  only a few scenes instead of the whole grid\n"
+                     "  -v  print the speeds returned for every scene\n"
+                     "  -p  only run the presets whose name contains the given text\n"
+                     "  the parameters are set in all presets\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    bool quick = false, verbose = false;
+    string filter;
+    std::map<string, float> overrides;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        size_t equals = argument.find('=');
+        if (argument == "-q") {
+            quick = true;
+        } else if (argument == "-v") {
+            verbose = true;
+        } else if (argument == "-p" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (argument[0] != '-' && equals != string::npos && equals > 0) {
+            overrides[argument.substr(0, equals)] = (float) atof(argument.c_str() + equals + 1);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // the warnings of the greedy tracer about dropped peaks are not of interest here
+    std::streambuf *errors = std::cerr.rdbuf(nullptr);
+
+    vector<Preset> selected;
+    for (auto& preset : presets()) {
+        if (preset.name.find(filter) != string::npos) {
+            selected.push_back(preset);
+        }
+    }
+    vector<Statistics> statistics(selected.size());
+
+    if (verbose) {
+        std::cout << "# preset;speed (km/h);distance (m);frequency (Hz);snr (dB);returned speeds (km/h)\n";
+    }
+    for (auto& scene : scenes(quick)) {
+        vector<float> signal = DopplerScene::generate(scene);
+        signal.resize(signal.size() + DopplerSpeedCalculator(ACCURACY_SAMPLE_RATE).getPreferredBlockSize(), 0);
+
+        for (size_t p = 0; p < selected.size(); ++p) {
+            vector<float> speeds = analyse(selected[p], overrides, signal, statistics[p]);
+            statistics[p].scenes++;
+            if (!speeds.empty()) {
+                statistics[p].errors.push_back(speeds[0] - scene.speed);
+            }
+            if (verbose) {
+                std::cout << "# " << selected[p].name << ";" << scene.speed << ";" << scene.distance << ";"
+                          << scene.frequency << ";" << scene.signalToNoiseRatio << ";";
+                for (size_t s = 0; s < speeds.size(); ++s) {
+                    std::cout << (s > 0 ? " " : "") << speeds[s];
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    std::cout << "preset;scenes;detected;bias (km/h);rms error (km/h);median |error| (km/h);90% |error| (km/h);"
+                 "max |error| (km/h);samples/s\n";
+    for (size_t p = 0; p < selected.size(); ++p) {
+        report(selected[p], statistics[p]);
+    }
+
+    std::cerr.rdbuf(errors);
+    return 0;
+}
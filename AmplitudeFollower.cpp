@@ -7,6 +7,7 @@
 //
 
 #include "AmplitudeFollower.hpp"
+#include "VectorKernels.hpp"
 #include <vamp-sdk/FFT.h>
 
 #include <iostream>
@@ -18,6 +19,7 @@ using std::stringstream;
 using Vamp::RealTime;
 
 #include <cmath>
+#include <algorithm>
 
 AmplitudeFollower::AmplitudeFollower (float inputSampleRate) :
     Vamp::Plugin(inputSampleRate),
@@ -26,8 +28,28 @@ AmplitudeFollower::AmplitudeFollower (float inputSampleRate) :
     m_stepSize(0),
     m_blockSize(0),
     m_outputNumbers({}),
+    m_amplitudeOutput(0),
+    m_rmsOutput(0),
+    m_crestFactorOutput(0),
+    m_channelAmplitudeOutput(0),
+    m_channelRmsOutput(0),
+    m_channelCrestFactorOutput(0),
+    m_envelopeOutput(0),
+    m_channelEnvelopeOutput(0),
+    m_followEnvelope(false),
+    m_parameterValues(),
+    m_channelPeaks(),
+    m_channelSums(),
+    m_envelopeFollowers(),
+    m_envelopes(),
     m_featureSet(FeatureSet())
-    {}
+{
+    ParameterList parameters = this->getParameterDescriptors();
+    for (auto it=parameters.begin(); it < parameters.end(); ++it) {
+        ParameterDescriptor& desc = *it;
+        this->m_parameterValues[desc.identifier] = desc.defaultValue;
+    }
+}
 
 string AmplitudeFollower::getIdentifier() const {
     return "wunderwelt-amplitude-follower";
@@ -75,15 +97,59 @@ size_t AmplitudeFollower::getMaxChannelCount() const {
 
 AmplitudeFollower::ParameterList AmplitudeFollower::getParameterDescriptors() const
 {
-    ParameterList list;
-    return list;
+    ParameterList plist = ParameterList();
+
+    ParameterDescriptor desc = ParameterDescriptor();
+    desc.identifier = ENVELOPE_FOLLOWER_ID;
+    desc.name = "Envelope Follower";
+    desc.description = "Set to 1 to additionally follow the envelope of each channel with the given attack and release times, independent of the block size (the step size must not be larger than the block size)";
+    desc.defaultValue = ENVELOPE_FOLLOWER;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = 1;
+    desc.valueNames = std::vector<std::string>{"off", "on"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = ATTACK_TIME_ID;
+    desc.name = "Attack Time";
+    desc.description = "Time constant with which the envelope follows a rising amplitude";
+    desc.unit = "ms";
+    desc.defaultValue = ATTACK_TIME;
+    desc.minValue = 0;
+    desc.maxValue = 1000;
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = RELEASE_TIME_ID;
+    desc.name = "Release Time";
+    desc.description = "Time constant with which the envelope follows a falling amplitude";
+    desc.unit = "ms";
+    desc.defaultValue = RELEASE_TIME;
+    desc.minValue = 0;
+    desc.maxValue = 5000;
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = ENVELOPE_RATE_ID;
+    desc.name = "Envelope Rate";
+    desc.description = "Number of values of the envelope per second (rounded so that a value is returned every multiple of 16 samples)";
+    desc.unit = "Hz";
+    desc.defaultValue = ENVELOPE_RATE;
+    desc.minValue = 1;
+    desc.maxValue = 1000;
+    plist.push_back(desc);
+
+    return plist;
 }
 
 float AmplitudeFollower::getParameter(string identifier) const {
-    return 0;
+    return this->m_parameterValues.at(identifier);
 }
 
 void AmplitudeFollower::setParameter(string identifier, float value) {
+    this->m_parameterValues[identifier] = value;
 }
 
 AmplitudeFollower::ProgramList AmplitudeFollower::getPrograms() const {
@@ -119,6 +185,66 @@ AmplitudeFollower::OutputList AmplitudeFollower::getOutputDescriptors() const
     m_outputNumbers[d.identifier] = n++;
     list.push_back(d);
 
+    d.identifier = "curve-rms";
+    d.name = "Curve: RMS";
+    d.description = "For each step a feature with the RMS of the block over all channels is returned.";
+    m_outputNumbers[d.identifier] = n++;
+    list.push_back(d);
+
+    d.identifier = "curve-crest-factor";
+    d.name = "Curve: Crest Factor";
+    d.description = "For each step a feature with the ratio of the maximum value and the RMS of the block over all channels is returned (0 for silence).";
+    m_outputNumbers[d.identifier] = n++;
+    list.push_back(d);
+
+    // the same statistics for every channel, one bin per channel
+    vector<string> channelNames;
+    for (size_t c = 0; c < m_channels; ++c) {
+        stringstream name;
+        name << "Channel " << (c + 1);
+        channelNames.push_back(name.str());
+    }
+    d.binCount = m_channels;
+    d.binNames = channelNames;
+
+    d.identifier = "channel-amplitude";
+    d.name = "Channels: Amplitude";
+    d.description = "For each step a feature with the maximum value of the block of each channel is returned.";
+    m_outputNumbers[d.identifier] = n++;
+    list.push_back(d);
+
+    d.identifier = "channel-rms";
+    d.name = "Channels: RMS";
+    d.description = "For each step a feature with the RMS of the block of each channel is returned.";
+    m_outputNumbers[d.identifier] = n++;
+    list.push_back(d);
+
+    d.identifier = "channel-crest-factor";
+    d.name = "Channels: Crest Factor";
+    d.description = "For each step a feature with the ratio of the maximum value and the RMS of the block of each channel is returned (0 for silence).";
+    m_outputNumbers[d.identifier] = n++;
+    list.push_back(d);
+
+    if (m_parameterValues.at(ENVELOPE_FOLLOWER_ID) == 1) {
+        d.identifier = "envelope";
+        d.name = "Envelope";
+        d.description = "The highest envelope of all channels, sampled at the envelope rate.";
+        d.binCount = 1;
+        d.binNames.clear();
+        d.sampleType = OutputDescriptor::FixedSampleRate;
+        d.sampleRate = m_inputSampleRate / getEnvelopeHopSize();
+        m_outputNumbers[d.identifier] = n++;
+        list.push_back(d);
+
+        d.identifier = "channel-envelope";
+        d.name = "Channels: Envelope";
+        d.description = "The envelope of each channel, sampled at the envelope rate.";
+        d.binCount = m_channels;
+        d.binNames = channelNames;
+        m_outputNumbers[d.identifier] = n++;
+        list.push_back(d);
+    }
+
     return list;
 }
 
@@ -126,40 +252,131 @@ bool AmplitudeFollower::initialise(size_t channels, size_t stepSize, size_t bloc
     if (channels < getMinChannelCount() ||
         channels > getMaxChannelCount()) return false;
 
+    // the envelope is followed through the first stepSize samples of every block, so with gaps between the blocks
+    // there would be samples missing (and the host's buffer would be read past its end)
+    if (m_parameterValues[ENVELOPE_FOLLOWER_ID] == 1 && stepSize > blockSize) {
+        std::cerr << "WARNING: the envelope follower needs a step size which is not larger than the block size\n";
+        return false;
+    }
+
     m_channels = channels;
     m_stepSize = stepSize;
     m_blockSize = blockSize;
+    m_channelPeaks.assign(channels, 0);
+    m_channelSums.assign(channels, 0);
+
+    size_t hopSize = getEnvelopeHopSize();
+    float samplesPerMs = m_inputSampleRate / 1000;
+    m_envelopeFollowers.assign(channels, EnvelopeFollower());
+    m_envelopes.assign(channels, vector<float>(stepSize / hopSize + 1));
+    for (size_t c = 0; c < channels; ++c) {
+        m_envelopeFollowers[c].initialise(m_parameterValues[ATTACK_TIME_ID] * samplesPerMs,
+                                          m_parameterValues[RELEASE_TIME_ID] * samplesPerMs, hopSize);
+    }
+
+    // the numbers of the outputs are needed in process, even if the host didn't ask for the descriptors
+    getOutputDescriptors();
+    m_amplitudeOutput = m_outputNumbers["curve-fsr-amplitude"];
+    m_rmsOutput = m_outputNumbers["curve-rms"];
+    m_crestFactorOutput = m_outputNumbers["curve-crest-factor"];
+    m_channelAmplitudeOutput = m_outputNumbers["channel-amplitude"];
+    m_channelRmsOutput = m_outputNumbers["channel-rms"];
+    m_channelCrestFactorOutput = m_outputNumbers["channel-crest-factor"];
+    m_followEnvelope = m_parameterValues[ENVELOPE_FOLLOWER_ID] == 1;
+    if (m_followEnvelope) {
+        m_envelopeOutput = m_outputNumbers["envelope"];
+        m_channelEnvelopeOutput = m_outputNumbers["channel-envelope"];
+    }
 
     return true;
 }
 
 void AmplitudeFollower::reset() {
     m_blocksProcessed = 0;
+    for (auto& follower : m_envelopeFollowers) {
+        follower.reset();
+    }
 }
 
 
 AmplitudeFollower::FeatureSet AmplitudeFollower::process(const float *const *inputBuffers, RealTime timestamp) {
+    // peak and sum of squares of every channel in a single pass over its samples
+    float peak = 0;
+    double sumOfSquares = 0;
+    for (size_t c = 0; c < m_channels; ++c) {
+        VectorKernels::peakAndSumOfSquares(inputBuffers[c], m_blockSize, m_channelPeaks[c], m_channelSums[c]);
+        peak = fmax(peak, m_channelPeaks[c]);
+        sumOfSquares += m_channelSums[c];
+    }
+    float rms = sqrt(sumOfSquares / (m_channels * m_blockSize));
+
     Feature f;
     f.hasTimestamp = true;
     f.timestamp = timestamp;
     f.hasDuration = false;
 
-    float maxVal = 0;
+    // we have bin count --> only one value per feature
+    FeatureSet fs;
+    f.values.assign(1, peak);
+    fs[m_amplitudeOutput].push_back(f);
+    f.values.assign(1, rms);
+    fs[m_rmsOutput].push_back(f);
+    f.values.assign(1, getCrestFactor(peak, rms));
+    fs[m_crestFactorOutput].push_back(f);
+
+    Feature rmsFeature = f;
+    Feature crestFeature = f;
+    f.values.resize(m_channels);
+    rmsFeature.values.resize(m_channels);
+    crestFeature.values.resize(m_channels);
+    for (size_t c = 0; c < m_channels; ++c) {
+        float channelRms = sqrt(m_channelSums[c] / m_blockSize);
+        f.values[c] = m_channelPeaks[c];
+        rmsFeature.values[c] = channelRms;
+        crestFeature.values[c] = getCrestFactor(m_channelPeaks[c], channelRms);
+    }
+    fs[m_channelAmplitudeOutput].push_back(f);
+    fs[m_channelRmsOutput].push_back(rmsFeature);
+    fs[m_channelCrestFactorOutput].push_back(crestFeature);
+
+    if (m_followEnvelope) {
+        // only the new samples of the block are followed, the rest is the beginning of the next block
+        // (initialise made sure that the step isn't larger than the block)
+        size_t firstOutput = m_envelopeFollowers[0].getSamplesUntilOutput();
+        size_t count = 0;
+        for (size_t c = 0; c < m_channels; ++c) {
+            count = m_envelopeFollowers[c].process(inputBuffers[c], m_stepSize, m_envelopes[c].data());
+        }
 
-    for (int c = 0; c < m_channels; ++c) {
-        // first value plus number of non-zero values
-        for (int i = 0; i < m_blockSize; ++i) {
-            maxVal = fmax(maxVal, fabsf(inputBuffers[c][i]));
+        Feature envelope;
+        envelope.hasTimestamp = true;
+        envelope.hasDuration = false;
+        Feature channelEnvelopes = envelope;
+        channelEnvelopes.values.resize(m_channels);
+        for (size_t i = 0; i < count; ++i) {
+            // the value belongs to the end of the hop
+            envelope.timestamp = timestamp + RealTime::frame2RealTime(firstOutput + i * getEnvelopeHopSize(), m_inputSampleRate);
+            channelEnvelopes.timestamp = envelope.timestamp;
+            float maxEnvelope = 0;
+            for (size_t c = 0; c < m_channels; ++c) {
+                channelEnvelopes.values[c] = m_envelopes[c][i];
+                maxEnvelope = fmax(maxEnvelope, m_envelopes[c][i]);
+            }
+            envelope.values.assign(1, maxEnvelope);
+            fs[m_envelopeOutput].push_back(envelope);
+            fs[m_channelEnvelopeOutput].push_back(channelEnvelopes);
         }
     }
+    return fs;
+}
 
-    // we have bin count --> only one value per feature
-    f.values.push_back(maxVal);
+float AmplitudeFollower::getCrestFactor(float peak, float rms) {
+    return rms > 0 ? peak / rms : 0;
+}
 
-    // put the feature into the feature set
-    FeatureSet fs;
-    fs[m_outputNumbers["curve-fsr-amplitude"]].push_back(f);
-    return fs;
+size_t AmplitudeFollower::getEnvelopeHopSize() const {
+    float chunks = m_inputSampleRate / m_parameterValues.at(ENVELOPE_RATE_ID) / VECTOR_KERNELS_CHUNK_LENGTH;
+    return std::max<size_t>(lrintf(chunks), 1) * VECTOR_KERNELS_CHUNK_LENGTH;
 }
 
 AmplitudeFollower::FeatureSet AmplitudeFollower::getRemainingFeatures() {
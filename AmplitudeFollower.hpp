@@ -12,8 +12,22 @@
 #include <stdio.h>
 #include <vamp-sdk/Plugin.h>
 
+#include "EnvelopeFollower.hpp"
+
 using std::string;
 
+// Parameter Identifiers
+#define ENVELOPE_FOLLOWER_ID "envelope-follower"
+#define ATTACK_TIME_ID "attack-time"
+#define RELEASE_TIME_ID "release-time"
+#define ENVELOPE_RATE_ID "envelope-rate"
+
+// Parameter Default Values
+#define ENVELOPE_FOLLOWER 0 // off
+#define ATTACK_TIME 5.0 // ms
+#define RELEASE_TIME 100.0 // ms
+#define ENVELOPE_RATE 100.0 // Hz
+
 class AmplitudeFollower : public Vamp::Plugin {
 
 public:
@@ -51,11 +65,37 @@ public:
     FeatureSet getRemainingFeatures();
 
 private:
+    // the ratio of the peak and the RMS, 0 if the block is silent
+    static float getCrestFactor(float peak, float rms);
+
+    // number of samples between two values of the envelope, a multiple of the chunk length of the envelope follower
+    size_t getEnvelopeHopSize() const;
+
     size_t m_blocksProcessed;
     size_t m_channels;
     size_t m_stepSize;
     size_t m_blockSize;
     mutable std::map<std::string, int> m_outputNumbers;
+
+    // the numbers of the outputs written while processing, looked up once in initialise
+    int m_amplitudeOutput;
+    int m_rmsOutput;
+    int m_crestFactorOutput;
+    int m_channelAmplitudeOutput;
+    int m_channelRmsOutput;
+    int m_channelCrestFactorOutput;
+    int m_envelopeOutput;
+    int m_channelEnvelopeOutput;
+    bool m_followEnvelope;
+    std::map<std::string, float> m_parameterValues;
+
+    // the peaks and sums of squares of the channels in the current block
+    std::vector<float> m_channelPeaks;
+    std::vector<float> m_channelSums;
+
+    // one envelope follower per channel and the values of the envelopes which were completed in the current block
+    std::vector<EnvelopeFollower> m_envelopeFollowers;
+    std::vector<std::vector<float>> m_envelopes;
     FeatureSet m_featureSet;
 };
 
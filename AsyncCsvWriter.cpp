@@ -0,0 +1,137 @@
+//
+//  AsyncCsvWriter.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "AsyncCsvWriter.hpp"
+#include <string.h>
+#include <chrono>
+#include <iostream>
+
+// the longest value written by %g (e.g. "-1.23457e-308;") fits into that many characters
+# define ASYNC_CSV_VALUE_LENGTH 16
+
+AsyncCsvWriter::AsyncCsvWriter():
+    file(nullptr),
+    frameSize(0),
+    pushed(0),
+    written(0),
+    dropped(0),
+    droppedRun(0),
+    waiting(false),
+    stopping(false) {
+}
+
+AsyncCsvWriter::~AsyncCsvWriter() {
+    close();
+}
+
+bool AsyncCsvWriter::open(const std::string & path, const std::string & header, size_t frameSize) {
+    close();
+
+    this->file = fopen(path.c_str(), "w");
+    if (this->file == nullptr) {
+        return false;
+    }
+    fputs(header.c_str(), this->file);
+    fputs("\n", this->file);
+
+    this->frameSize = frameSize;
+    this->frames.assign(ASYNC_CSV_QUEUE_LENGTH * frameSize, 0);
+    this->droppedBefore.assign(ASYNC_CSV_QUEUE_LENGTH, 0);
+    this->line.resize(frameSize * ASYNC_CSV_VALUE_LENGTH + 2);
+    this->pushed = 0;
+    this->written = 0;
+    this->dropped = 0;
+    this->droppedRun = 0;
+    this->waiting = false;
+    this->stopping = false;
+    this->writer = std::thread(&AsyncCsvWriter::write, this);
+    return true;
+}
+
+void AsyncCsvWriter::close() {
+    if (this->file == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_one();
+    this->writer.join();
+
+    // the frames dropped after the last written one
+    if (this->droppedRun > 0) {
+        writeDropped(this->droppedRun);
+        this->droppedRun = 0;
+    }
+    fclose(this->file);
+    this->file = nullptr;
+    if (this->dropped > 0) {
+        std::cerr << "WARNING: " << this->dropped << " frames of the debug csv file were dropped\n";
+    }
+}
+
+void AsyncCsvWriter::push(const float *frame) {
+    size_t next = this->pushed.load(std::memory_order_relaxed);
+    if (next - this->written.load(std::memory_order_acquire) >= ASYNC_CSV_QUEUE_LENGTH) {
+        this->dropped++;
+        this->droppedRun++;
+        return;
+    }
+
+    size_t slot = next % ASYNC_CSV_QUEUE_LENGTH;
+    memcpy(&this->frames[slot * this->frameSize], frame, this->frameSize * sizeof(float));
+    this->droppedBefore[slot] = this->droppedRun;
+    this->droppedRun = 0;
+    this->pushed.store(next + 1);
+
+    // the writer sets waiting before it checks the queue for the last time, so either it sees this frame or it is
+    // notified; it also wakes up by itself every few milliseconds, so a notification which comes before it actually
+    // waits only delays it
+    if (this->waiting.load()) {
+        this->wake.notify_one();
+    }
+}
+
+void AsyncCsvWriter::write() {
+    while (true) {
+        size_t next = this->written.load(std::memory_order_relaxed);
+        if (next < this->pushed.load(std::memory_order_acquire)) {
+            size_t slot = next % ASYNC_CSV_QUEUE_LENGTH;
+            if (this->droppedBefore[slot] > 0) {
+                writeDropped(this->droppedBefore[slot]);
+            }
+            writeFrame(&this->frames[slot * this->frameSize]);
+            this->written.store(next + 1, std::memory_order_release);
+            continue;
+        }
+
+        // the queue is empty, all frames pushed before close are written at this point
+        if (this->stopping) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->waiting.store(true);
+        if (!this->stopping && this->pushed.load() == next) {
+            this->wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        this->waiting.store(false);
+    }
+    fflush(this->file);
+}
+
+void AsyncCsvWriter::writeFrame(const float *frame) {
+    char *out = this->line.data();
+    for (size_t i = 0; i < this->frameSize; ++i) {
+        out += snprintf(out, ASYNC_CSV_VALUE_LENGTH, "%g;", frame[i]);
+    }
+    *out++ = '\n';
+    fwrite(this->line.data(), 1, out - this->line.data(), this->file);
+}
+
+void AsyncCsvWriter::writeDropped(size_t count) {
+    fprintf(this->file, "# %zu frames dropped\n", count);
+}
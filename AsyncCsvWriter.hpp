@@ -0,0 +1,88 @@
+//
+//  AsyncCsvWriter.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef AsyncCsvWriter_hpp
+#define AsyncCsvWriter_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// number of frames which can wait for being written before further frames are dropped
+# define ASYNC_CSV_QUEUE_LENGTH 256
+
+// AsyncCsvWriter writes frames of floats as lines of a csv file on a background thread. The frames are copied to a
+// lock-free ring buffer with a single producer and a single consumer, the formatting and the file access happen on the
+// background thread only. If the writer can't keep up, frames are dropped instead of blocking the producer, and every
+// run of dropped frames is replaced by a comment line "# <n> frames dropped", so the lines can still be matched to the
+// frames (csv readers like numpy.loadtxt skip such lines by default).
+// Nothing is started unless the writer is opened, so push is never called when debugging is off.
+class AsyncCsvWriter {
+
+public:
+    AsyncCsvWriter();
+    ~AsyncCsvWriter();
+
+    // opens the file, writes the header line (without line break) and starts the writer thread for frames of frameSize
+    // values, a file which was opened before is closed first; returns false if the file can't be opened
+    bool open(const std::string & path, const std::string & header, size_t frameSize);
+
+    // writes the remaining frames, stops the writer thread and closes the file
+    void close();
+
+    bool isOpen() const {
+        return this->file != nullptr;
+    }
+
+    // queues a frame of frameSize values to be written as a line, must only be called by one thread at a time
+    void push(const float *frame);
+
+    // number of frames which were dropped because the queue was full
+    size_t getDroppedFrames() const {
+        return this->dropped;
+    }
+
+private:
+    // main function of the writer thread
+    void write();
+
+    // formats the frame as a line and writes it to the file
+    void writeFrame(const float *frame);
+
+    // writes the comment line which stands for the given number of dropped frames
+    void writeDropped(size_t count);
+
+    FILE *file;
+    size_t frameSize;
+
+    // ASYNC_CSV_QUEUE_LENGTH frames, frame number i is at slot i % ASYNC_CSV_QUEUE_LENGTH,
+    // and the number of frames which were dropped right before the frame in each slot
+    std::vector<float> frames;
+    std::vector<size_t> droppedBefore;
+
+    // number of frames pushed by the producer and written by the writer thread so far
+    std::atomic<size_t> pushed;
+    std::atomic<size_t> written;
+    size_t dropped;
+
+    // frames dropped since the last frame which was queued, only used by the producer (and by close)
+    size_t droppedRun;
+
+    // the writer thread sleeps while the queue is empty, the producer only notifies it while it is waiting
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> waiting;
+    std::atomic<bool> stopping;
+
+    // the formatted line, reused for every frame
+    std::vector<char> line;
+};
+
+#endif /* AsyncCsvWriter_hpp */
@@ -0,0 +1,574 @@
+//
+//  Batch.cpp
+//  wunderwelt-vamp-plugin
+//
+//  Analyses many wav files with the speed calculator of the plugin library and writes the speeds as csv or json.
+//  The library is loaded through vampGetPluginDescriptor like any other host does it, the files are mapped into
+//  memory and the blocks are passed to the plugin directly from the mapping where the format allows it (mono 32 bit
+//  float), otherwise they are converted block by block. The files are spread over the threads of a WorkerPool and
+//  every thread keeps its plugin instance for the next file as long as sample rate and channel count stay the same.
+//
+
+#include "MappedFile.hpp"
+#include "WorkerPool.hpp"
+
+#include <vamp/vamp.h>
+#include <vamp-sdk/RealTime.h>
+
+#include <dlfcn.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+# define BATCH_DEFAULT_LIBRARY "./wunderwelt-vamp-plugin.so"
+# define BATCH_DEFAULT_PLUGIN "doppler-speed-calculator-td"
+# define BATCH_SPEED_OUTPUT "naive-speed-of-source"
+
+# define WAVE_FORMAT_PCM 1
+# define WAVE_FORMAT_IEEE_FLOAT 3
+# define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+namespace {
+
+    struct Speed {
+        double time;
+        float speed;
+        string label;
+    };
+
+    struct Result {
+        string error;
+        vector<Speed> speeds;
+    };
+
+    uint16_t readUint16(const char *data) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        return (uint16_t) (bytes[0] | bytes[1] << 8);
+    }
+
+    uint32_t readUint32(const char *data) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+    }
+
+    // WavFile maps a RIFF wave file with 16, 24 or 32 bit integer or 32 bit float samples (little endian, like the
+    // machines the tool runs on) and converts blocks of it to one float buffer per channel
+    class WavFile {
+
+    public:
+        // returns an empty string if the file was mapped, otherwise the reason why not
+        string open(const string & path) {
+            if (!this->file.open(path)) {
+                return "can't map the file";
+            }
+            const char *data = this->file.getData();
+            size_t size = this->file.getSize();
+            if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+                return "no RIFF wave file";
+            }
+
+            uint16_t format = 0;
+            this->samples = nullptr;
+            for (size_t chunk = 12; chunk + 8 <= size; ) {
+                uint32_t chunkSize = readUint32(data + chunk + 4);
+                const char *body = data + chunk + 8;
+                size_t available = std::min<size_t>(chunkSize, size - chunk - 8);
+                if (memcmp(data + chunk, "fmt ", 4) == 0 && available >= 16) {
+                    format = readUint16(body);
+                    this->channels = readUint16(body + 2);
+                    this->sampleRate = readUint32(body + 4);
+                    this->frameSize = readUint16(body + 12);
+                    this->bitsPerSample = readUint16(body + 14);
+                    if (format == WAVE_FORMAT_EXTENSIBLE && available >= 26) {
+                        // the first two bytes of the sub format GUID are the actual format
+                        format = readUint16(body + 24);
+                    }
+                } else if (memcmp(data + chunk, "data", 4) == 0) {
+                    this->samples = body;
+                    this->dataSize = available;
+                }
+                chunk += 8 + (size_t) chunkSize + (chunkSize & 1);
+            }
+
+            if (format == 0 || this->samples == nullptr) {
+                return "fmt or data chunk missing";
+            }
+            bool supported = (format == WAVE_FORMAT_PCM && (this->bitsPerSample == 16 || this->bitsPerSample == 24 || this->bitsPerSample == 32)) ||
+                (format == WAVE_FORMAT_IEEE_FLOAT && this->bitsPerSample == 32);
+            if (!supported || this->channels == 0 || this->sampleRate == 0 || this->frameSize != this->channels * this->bitsPerSample / 8) {
+                return "unsupported sample format";
+            }
+            this->isFloat = format == WAVE_FORMAT_IEEE_FLOAT;
+            this->frames = this->dataSize / this->frameSize;
+            return "";
+        }
+
+        // the samples of a mono float file can be passed to the plugin without converting them
+        bool canMapBlocks() const {
+            return this->isFloat && this->channels == 1 && reinterpret_cast<uintptr_t>(this->samples) % alignof(float) == 0;
+        }
+
+        const float* getMappedBlock(size_t start) const {
+            return reinterpret_cast<const float *>(this->samples) + start;
+        }
+
+        // converts count frames from start on to the buffers (one per channel), frames behind the end of the file are 0
+        void readBlock(size_t start, size_t count, vector<vector<float>> & buffers) const {
+            size_t available = start < this->frames ? std::min(count, this->frames - start) : 0;
+            size_t bytes = this->bitsPerSample / 8;
+            for (size_t c = 0; c < this->channels; ++c) {
+                float *output = buffers[c].data();
+                const char *sample = this->samples + start * this->frameSize + c * bytes;
+                for (size_t i = 0; i < available; ++i, sample += this->frameSize) {
+                    output[i] = convert(sample);
+                }
+                std::fill(output + available, output + count, 0.0f);
+            }
+        }
+
+        size_t getChannels() const {
+            return this->channels;
+        }
+
+        size_t getSampleRate() const {
+            return this->sampleRate;
+        }
+
+        size_t getFrames() const {
+            return this->frames;
+        }
+
+    private:
+        float convert(const char *sample) const {
+            if (this->isFloat) {
+                float value;
+                memcpy(&value, sample, sizeof(value));
+                return value;
+            }
+            switch (this->bitsPerSample) {
+                case 16: return (int16_t) readUint16(sample) / 32768.0f;
+                case 24: return (int32_t) ((uint32_t) readUint16(sample) << 8 | (uint32_t) (unsigned char) sample[2] << 24) / 2147483648.0f;
+                default: return (int32_t) readUint32(sample) / 2147483648.0f;
+            }
+        }
+
+        MappedFile file;
+        const char *samples = nullptr;
+        size_t dataSize = 0;
+        size_t channels = 0;
+        size_t sampleRate = 0;
+        size_t frameSize = 0;
+        size_t bitsPerSample = 0;
+        size_t frames = 0;
+        bool isFloat = false;
+    };
+
+    // an instance of the plugin together with the buffers of the thread which uses it
+    struct Instance {
+        VampPluginHandle handle;
+        size_t sampleRate;
+        size_t channels;
+        size_t stepSize;
+        size_t blockSize;
+        int speedOutput;
+        vector<vector<float>> buffers;
+        vector<const float *> inputs;
+    };
+
+    class Batch {
+
+    public:
+        Batch(const VampPluginDescriptor *descriptor, const std::map<string, float> & parameters):
+            descriptor(descriptor),
+            parameters() {
+            for (auto& parameter : parameters) {
+                for (unsigned int i = 0; i < descriptor->parameterCount; ++i) {
+                    if (parameter.first == descriptor->parameters[i]->identifier) {
+                        this->parameters[(int) i] = parameter.second;
+                    }
+                }
+            }
+        }
+
+        ~Batch() {
+            for (auto& instance : this->instances) {
+                this->descriptor->cleanup(instance->handle);
+            }
+        }
+
+        Result analyse(const string & path) {
+            Result result;
+            WavFile wav;
+            result.error = wav.open(path);
+            if (!result.error.empty()) {
+                return result;
+            }
+
+            std::unique_ptr<Instance> instance = acquire(wav.getSampleRate(), wav.getChannels(), result.error);
+            if (!instance) {
+                return result;
+            }
+
+            bool mapped = wav.canMapBlocks();
+            for (size_t start = 0; start < wav.getFrames(); start += instance->stepSize) {
+                if (mapped && start + instance->blockSize <= wav.getFrames()) {
+                    instance->inputs[0] = wav.getMappedBlock(start);
+                } else {
+                    wav.readBlock(start, instance->blockSize, instance->buffers);
+                    for (size_t c = 0; c < instance->channels; ++c) {
+                        instance->inputs[c] = instance->buffers[c].data();
+                    }
+                }
+                RealTime timestamp = RealTime::frame2RealTime(start, (unsigned int) wav.getSampleRate());
+                collect(*instance, this->descriptor->process(instance->handle, instance->inputs.data(), timestamp.sec, timestamp.nsec), result);
+            }
+            collect(*instance, this->descriptor->getRemainingFeatures(instance->handle), result);
+
+            release(std::move(instance));
+            return result;
+        }
+
+    private:
+        // takes an instance for the given format from the free ones or creates a new one
+        std::unique_ptr<Instance> acquire(size_t sampleRate, size_t channels, string & error) {
+            std::unique_ptr<Instance> instance;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                for (auto it = this->instances.begin(); it != this->instances.end(); ++it) {
+                    if ((*it)->sampleRate == sampleRate && (*it)->channels == channels) {
+                        instance = std::move(*it);
+                        this->instances.erase(it);
+                        break;
+                    }
+                }
+                // the instances of other formats are not needed by this thread any more
+                if (!instance && !this->instances.empty()) {
+                    this->descriptor->cleanup(this->instances.back()->handle);
+                    this->instances.pop_back();
+                }
+            }
+            if (instance) {
+                this->descriptor->reset(instance->handle);
+                return instance;
+            }
+
+            instance.reset(new Instance());
+            instance->sampleRate = sampleRate;
+            instance->channels = channels;
+            {
+                // the adapter of the plugin library keeps track of its instances, so they are created one at a time
+                std::lock_guard<std::mutex> lock(this->mutex);
+                instance->handle = this->descriptor->instantiate(this->descriptor, (float) sampleRate);
+            }
+            if (instance->handle == nullptr) {
+                error = "can't instantiate the plugin";
+                return nullptr;
+            }
+            for (auto& parameter : this->parameters) {
+                this->descriptor->setParameter(instance->handle, parameter.first, parameter.second);
+            }
+
+            instance->speedOutput = -1;
+            for (unsigned int i = 0; i < this->descriptor->getOutputCount(instance->handle); ++i) {
+                VampOutputDescriptor *output = this->descriptor->getOutputDescriptor(instance->handle, i);
+                if (strcmp(output->identifier, BATCH_SPEED_OUTPUT) == 0) {
+                    instance->speedOutput = (int) i;
+                }
+                this->descriptor->releaseOutputDescriptor(output);
+            }
+
+            instance->stepSize = this->descriptor->getPreferredStepSize(instance->handle);
+            instance->blockSize = this->descriptor->getPreferredBlockSize(instance->handle);
+            if (instance->blockSize == 0) {
+                instance->blockSize = 1024;
+            }
+            if (instance->stepSize == 0) {
+                instance->stepSize = instance->blockSize;
+            }
+            if (instance->speedOutput < 0 || channels < this->descriptor->getMinChannelCount(instance->handle) ||
+                channels > this->descriptor->getMaxChannelCount(instance->handle) ||
+                !this->descriptor->initialise(instance->handle, (unsigned int) channels, (unsigned int) instance->stepSize,
+                                              (unsigned int) instance->blockSize)) {
+                this->descriptor->cleanup(instance->handle);
+                std::stringstream message;
+                message << "the plugin can't analyse " << channels << " channels at " << sampleRate << " Hz";
+                error = message.str();
+                return nullptr;
+            }
+            instance->buffers.assign(channels, vector<float>(instance->blockSize));
+            instance->inputs.assign(channels, nullptr);
+            return instance;
+        }
+
+        void release(std::unique_ptr<Instance> instance) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->instances.push_back(std::move(instance));
+        }
+
+        // takes the speeds from the features returned by the plugin and releases them
+        void collect(const Instance & instance, VampFeatureList *features, Result & result) {
+            if (features == nullptr) {
+                return;
+            }
+            const VampFeatureList & speeds = features[instance.speedOutput];
+            for (unsigned int i = 0; i < speeds.featureCount; ++i) {
+                const VampFeature & feature = speeds.features[i].v1;
+                if (feature.valueCount == 0) {
+                    continue;
+                }
+                Speed speed;
+                speed.time = feature.sec + feature.nsec / 1e9;
+                speed.speed = feature.values[0];
+                speed.label = feature.label != nullptr ? feature.label : "";
+                result.speeds.push_back(speed);
+            }
+            this->descriptor->releaseFeatureSet(features);
+        }
+
+        const VampPluginDescriptor *descriptor;
+        std::map<int, float> parameters;
+
+        // the instances which are not used at the moment, there are never more than there are threads
+        std::mutex mutex;
+        vector<std::unique_ptr<Instance>> instances;
+    };
+
+    bool isWavFile(const string & name) {
+        if (name.size() < 4) {
+            return false;
+        }
+        string extension = name.substr(name.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".wav";
+    }
+
+    // adds the path if it is a file, or all wav files below it if it is a directory
+    void findFiles(const string & path, vector<string> & files) {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0) {
+            std::cerr << "WARNING: " << path << " doesn't exist\n";
+            return;
+        }
+        if (!S_ISDIR(status.st_mode)) {
+            files.push_back(path);
+            return;
+        }
+        DIR *directory = opendir(path.c_str());
+        if (directory == nullptr) {
+            std::cerr << "WARNING: can't read the directory " << path << "\n";
+            return;
+        }
+        vector<string> entries;
+        while (struct dirent *entry = readdir(directory)) {
+            string name = entry->d_name;
+            if (name != "." && name != "..") {
+                entries.push_back(name);
+            }
+        }
+        closedir(directory);
+
+        std::sort(entries.begin(), entries.end());
+        for (auto& name : entries) {
+            string child = path + (path.back() == '/' ? "" : "/") + name;
+            if (stat(child.c_str(), &status) == 0 && (S_ISDIR(status.st_mode) || isWavFile(name))) {
+                findFiles(child, files);
+            }
+        }
+    }
+
+    string csvField(const string & value) {
+        if (value.find_first_of(";\"\n") == string::npos) {
+            return value;
+        }
+        string quoted = "\"";
+        for (char c : value) {
+            quoted += c == '"' ? "\"\"" : string(1, c);
+        }
+        return quoted + "\"";
+    }
+
+    string jsonString(const string & value) {
+        std::stringstream quoted;
+        quoted << '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                quoted << '\\' << c;
+            } else if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted << escaped;
+            } else {
+                quoted << c;
+            }
+        }
+        quoted << '"';
+        return quoted.str();
+    }
+
+    // one line per speed, files without a speed get a line with empty values
+    void writeCsv(std::ostream & out, const vector<string> & files, const vector<Result> & results) {
+        out << "file;time (s);speed (km/h);label;error\n";
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (results[i].speeds.empty()) {
+                out << csvField(files[i]) << ";;;;" << csvField(results[i].error) << "\n";
+            }
+            for (auto& speed : results[i].speeds) {
+                out << csvField(files[i]) << ";" << speed.time << ";" << speed.speed << ";" << csvField(speed.label) << ";\n";
+            }
+        }
+    }
+
+    void writeJson(std::ostream & out, const vector<string> & files, const vector<Result> & results) {
+        out << "[\n";
+        for (size_t i = 0; i < files.size(); ++i) {
+            out << "  {\"file\": " << jsonString(files[i]) << ", \"speeds\": [";
+            for (size_t s = 0; s < results[i].speeds.size(); ++s) {
+                const Speed & speed = results[i].speeds[s];
+                out << (s > 0 ? ", " : "") << "{\"time\": " << speed.time << ", \"speed\": " << speed.speed
+                    << ", \"label\": " << jsonString(speed.label) << "}";
+            }
+            out << "], \"error\": " << (results[i].error.empty() ? "null" : jsonString(results[i].error)) << "}"
+                << (i + 1 < files.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    void printUsage() {
+        std::cerr << "usage: wunderwelt-batch [-j threads] [-l library] [-p plugin] [-f csv|json] [-o output]\n"
+                     "                        [<parameter>=<value>]... <file or directory>...\n"
+                     "  analyses the given wav files and all wav files below the given directories\n"
+                     "  -l  the plugin library (default " BATCH_DEFAULT_LIBRARY ")\n"
+                     "  -p  the identifier of the plugin (default " BATCH_DEFAULT_PLUGIN ")\n"
+                     "  -f  the format of the speeds written to the output (default csv)\n"
+                     "  -o  the output file (default stdout)\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    string library = BATCH_DEFAULT_LIBRARY;
+    string plugin = BATCH_DEFAULT_PLUGIN;
+    string format = "csv";
+    string outputPath;
+    std::map<string, float> parameters;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "-j" && hasValue) {
+            threads = std::max(atoi(argv[++i]), 1);
+        } else if (argument == "-l" && hasValue) {
+            library = argv[++i];
+        } else if (argument == "-p" && hasValue) {
+            plugin = argv[++i];
+        } else if (argument == "-f" && hasValue) {
+            format = argv[++i];
+        } else if (argument == "-o" && hasValue) {
+            outputPath = argv[++i];
+        } else if (argument[0] != '-' && argument.find('=') != string::npos) {
+            size_t equals = argument.find('=');
+            parameters[argument.substr(0, equals)] = (float) atof(argument.c_str() + equals + 1);
+        } else if (argument[0] != '-') {
+            paths.push_back(argument);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (paths.empty() || (format != "csv" && format != "json")) {
+        printUsage();
+        return 1;
+    }
+
+    // a relative path without a slash would make dlopen search the library path instead of the current directory
+    if (library.find('/') == string::npos) {
+        library = "./" + library;
+    }
+    void *libraryHandle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (libraryHandle == nullptr) {
+        std::cerr << "ERROR: can't load " << library << ": " << dlerror() << "\n";
+        return 1;
+    }
+    VampGetPluginDescriptorFunction getDescriptor = (VampGetPluginDescriptorFunction) dlsym(libraryHandle, "vampGetPluginDescriptor");
+    const VampPluginDescriptor *descriptor = nullptr;
+    for (unsigned int index = 0; getDescriptor != nullptr && descriptor == nullptr; ++index) {
+        const VampPluginDescriptor *candidate = getDescriptor(VAMP_API_VERSION, index);
+        if (candidate == nullptr) {
+            break;
+        }
+        if (plugin == candidate->identifier) {
+            descriptor = candidate;
+        }
+    }
+    if (descriptor == nullptr || descriptor->inputDomain != vampTimeDomain) {
+        std::cerr << "ERROR: " << library << " contains no time domain plugin " << plugin << "\n";
+        dlclose(libraryHandle);
+        return 1;
+    }
+    for (auto& parameter : parameters) {
+        bool known = false;
+        for (unsigned int i = 0; i < descriptor->parameterCount; ++i) {
+            known = known || parameter.first == descriptor->parameters[i]->identifier;
+        }
+        if (!known) {
+            std::cerr << "ERROR: the plugin has no parameter " << parameter.first << "\n";
+            dlclose(libraryHandle);
+            return 1;
+        }
+    }
+
+    vector<string> files;
+    for (auto& path : paths) {
+        findFiles(path, files);
+    }
+
+    vector<Result> results(files.size());
+    {
+        Batch batch(descriptor, parameters);
+        auto job = [&](size_t i) {
+            results[i] = batch.analyse(files[i]);
+        };
+        WorkerPool workers;
+        workers.start(std::min(threads, std::max<size_t>(files.size(), 1)) - 1);
+        workers.run(files.size(), job);
+        workers.stop();
+    }
+    dlclose(libraryHandle);
+
+    size_t failed = 0;
+    for (auto& result : results) {
+        failed += result.error.empty() ? 0 : 1;
+    }
+    std::cerr << "analysed " << files.size() - failed << " of " << files.size() << " files\n";
+
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath);
+        if (!outputFile) {
+            std::cerr << "ERROR: can't write " << outputPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream & output = outputPath.empty() ? std::cout : outputFile;
+    if (format == "json") {
+        writeJson(output, files, results);
+    } else {
+        writeCsv(output, files, results);
+    }
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,361 @@
+//
+//  Bench.cpp
+//  wunderwelt-vamp-plugin
+//
+//  Micro benchmarks of the hot paths of the plugins on synthetic Doppler chirps in noise. Every benchmark prints a
+//  csv line with the time per bin (per traced peak for the tracer, per sample for the amplitude follower) and per
+//  step. The output of an earlier run can be given with -c, then every benchmark is compared to it and the exit code
+//  is 1 if one got slower by more than the tolerance.
+//
+
+#include "AmplitudeFollower.hpp"
+#include "DopplerSpeedCalculator.hpp"
+#include "MovingAverage.hpp"
+#include "PeakFinder.hpp"
+#include "PeakTracer.hpp"
+#include "TimeDomainDopplerSpeedCalculator.hpp"
+#include "VectorKernels.hpp"
+
+#include <vamp-sdk/FFT.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+using PeakFinder::Peak;
+
+# define BENCH_SAMPLE_RATE 44100.0f
+# define BENCH_FRAMES 32 // different spectra which are cycled through
+# define BENCH_TRACE_STEPS 200
+# define BENCH_DEFAULT_TIME 0.5 // s per benchmark
+# define BENCH_ROUNDS 5
+# define BENCH_DEFAULT_TOLERANCE 0.1
+
+namespace {
+
+    struct Options {
+        double minTime;
+        double tolerance;
+        string filter;
+        std::map<string, double> baseline;
+        bool slower;
+    };
+
+    Options options = {BENCH_DEFAULT_TIME, BENCH_DEFAULT_TOLERANCE, "", {}, false};
+
+    // a source with three harmonics passing a microphone 5 m away with 60 km/h, in white noise
+    vector<float> dopplerSignal(size_t length, unsigned seed) {
+        const double speed = 60 / 3.6, distance = 5, speedOfSound = 343, frequency = 600;
+        vector<float> signal(length);
+        double phase = 0;
+        srand(seed);
+        for (size_t n = 0; n < length; ++n) {
+            double x = speed * (n / BENCH_SAMPLE_RATE - length / BENCH_SAMPLE_RATE / 2);
+            double r = sqrt(x * x + distance * distance);
+            phase += 2 * M_PI * frequency * speedOfSound / (speedOfSound + speed * x / r) / BENCH_SAMPLE_RATE;
+            double noise = 0.2 * (rand() / (double) RAND_MAX - 0.5);
+            signal[n] = (sin(phase) + 0.5 * sin(2 * phase + 1) + 0.25 * sin(3 * phase + 2)) * 5 / r + noise;
+        }
+        return signal;
+    }
+
+    // BENCH_FRAMES spectra (blockSize + 2 interleaved values each) of Hann windowed blocks spread over the passing
+    vector<vector<float>> dopplerSpectra(size_t blockSize) {
+        vector<float> signal = dopplerSignal(BENCH_SAMPLE_RATE * 4 + blockSize, 1);
+        size_t step = (signal.size() - blockSize) / BENCH_FRAMES;
+        Vamp::FFTReal fft((int) blockSize);
+        vector<double> input(blockSize), output(blockSize + 2);
+        vector<vector<float>> spectra(BENCH_FRAMES);
+        for (size_t f = 0; f < BENCH_FRAMES; ++f) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                input[i] = signal[f * step + i] * (0.5 - 0.5 * cos(2 * M_PI * i / blockSize));
+            }
+            fft.forward(input.data(), output.data());
+            spectra[f].assign(output.begin(), output.end());
+        }
+        return spectra;
+    }
+
+    // calls prepare (not measured) and run until minTime is spent in run, returns the time per step in ns
+    // the time is split into rounds and the fastest round counts, so other load on the machine hardly shows up
+    template<class Prepare, class Run>
+    double measure(size_t stepsPerRun, Prepare prepare, Run run) {
+        double fastest = 0;
+        for (size_t round = 0; round < BENCH_ROUNDS; ++round) {
+            std::chrono::steady_clock::duration spent(0);
+            size_t runs = 0;
+            while (runs < 1 || spent < std::chrono::duration<double>(options.minTime / BENCH_ROUNDS)) {
+                prepare();
+                auto start = std::chrono::steady_clock::now();
+                run();
+                spent += std::chrono::steady_clock::now() - start;
+                runs++;
+            }
+            double ns = std::chrono::duration<double, std::nano>(spent).count() / (runs * stepsPerRun);
+            fastest = round == 0 ? ns : std::min(fastest, ns);
+        }
+        return fastest;
+    }
+
+    bool selected(const string & name) {
+        return name.find(options.filter) != string::npos;
+    }
+
+    // prints the result and compares it to the baseline
+    void report(const string & name, double nsPerStep, size_t binsPerStep) {
+        std::cout << name << ";" << nsPerStep / binsPerStep << ";" << nsPerStep;
+        auto baseline = options.baseline.find(name);
+        if (baseline != options.baseline.end()) {
+            double change = nsPerStep / baseline->second - 1;
+            std::cout << ";" << (change > 0 ? "+" : "") << round(change * 1000) / 10 << "%";
+            if (change > options.tolerance) {
+                std::cout << " SLOWER";
+                options.slower = true;
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    void benchPeakFinder(size_t blockSize) {
+        string name = "peak-finder/" + std::to_string(blockSize);
+        if (!selected(name)) return;
+
+        size_t bins = blockSize / 2 + 1;
+        vector<vector<float>> spectra = dopplerSpectra(blockSize);
+        for (auto& spectrum : spectra) {
+            VectorKernels::magnitudes(spectrum.data(), spectrum.data(), bins);
+            VectorKernels::decibels(spectrum.data(), spectrum.data(), bins, 1.0f, 20.0f);
+            spectrum.resize(bins);
+        }
+        vector<Peak<float>> peaks(bins / 2 + 1);
+        size_t found = 0;
+        double ns = measure(BENCH_FRAMES, []() {}, [&]() {
+            for (auto& spectrum : spectra) {
+                found += PeakFinder::findPeaksThreshold(spectrum.begin(), spectrum.end(), 15.0f, RealTime::zeroTime,
+                                                        peaks.data(), peaks.size());
+            }
+        });
+        report(name, ns, bins);
+    }
+
+    // the magnitudes, moving average and decibels of DopplerSpeedCalculator::analyse
+    void benchMagnitudeAverage(size_t blockSize) {
+        string name = "magnitude-average/" + std::to_string(blockSize);
+        if (!selected(name)) return;
+
+        size_t bins = blockSize / 2 + 1;
+        vector<vector<float>> spectra = dopplerSpectra(blockSize);
+        vector<float> magnitudes(bins), decibels(bins);
+        MovingAverage<float> average;
+        average.initialise(MOVING_FFT_AVERAGE_WIDTH, bins);
+        double ns = measure(BENCH_FRAMES, []() {}, [&]() {
+            for (auto& spectrum : spectra) {
+                VectorKernels::magnitudes(spectrum.data(), magnitudes.data(), bins);
+                average.add(magnitudes.data());
+                VectorKernels::decibels(average.getSums(), decibels.data(), bins, 1.0f / MOVING_FFT_AVERAGE_WIDTH, 20.0f);
+            }
+        });
+        report(name, ns, bins);
+    }
+
+    // a whole step of the plugin including peak finding and tracing
+    void benchProcess(size_t blockSize) {
+        string name = "process/" + std::to_string(blockSize);
+        if (!selected(name)) return;
+
+        size_t stepSize = blockSize / 4;
+        vector<vector<float>> spectra = dopplerSpectra(blockSize);
+        DopplerSpeedCalculator calculator(BENCH_SAMPLE_RATE);
+        calculator.getOutputDescriptors();
+        if (!calculator.initialise(1, stepSize, blockSize)) {
+            std::cout << "# ERROR: can't initialise the plugin for " << name << "\n";
+            return;
+        }
+        size_t step = 0;
+        double ns = measure(BENCH_FRAMES, [&]() {
+            calculator.reset();
+            step = 0;
+        }, [&]() {
+            for (auto& spectrum : spectra) {
+                const float *input = spectrum.data();
+                calculator.process(&input, RealTime::frame2RealTime(step++ * stepSize, BENCH_SAMPLE_RATE));
+            }
+        });
+        report(name, ns, blockSize / 2 + 1);
+    }
+
+    // a whole step of the time domain plugin including its fft, with zoom decimated by 2 to the power of zoom before
+    void benchTimeDomainProcess(size_t blockSize, size_t zoom) {
+        string name = (zoom == NO_ZOOM ? string("process-td/") : "process-td-zoom-" + std::to_string(1 << zoom) + "x/") +
+                      std::to_string(blockSize);
+        if (!selected(name)) return;
+
+        size_t stepSize = blockSize / 4;
+        vector<float> signal = dopplerSignal(BENCH_FRAMES * stepSize + blockSize, 1);
+        TimeDomainDopplerSpeedCalculator calculator(BENCH_SAMPLE_RATE);
+        calculator.setParameter(ZOOM_ID, zoom);
+        calculator.getOutputDescriptors();
+        if (!calculator.initialise(1, stepSize, blockSize)) {
+            std::cout << "# ERROR: can't initialise the plugin for " << name << "\n";
+            return;
+        }
+        double ns = measure(BENCH_FRAMES, [&]() {
+            calculator.reset();
+        }, [&]() {
+            for (size_t step = 0; step < BENCH_FRAMES; ++step) {
+                const float *input = signal.data() + step * stepSize;
+                calculator.process(&input, RealTime::frame2RealTime(step * stepSize, BENCH_SAMPLE_RATE));
+            }
+        });
+        report(name, ns, blockSize / 2 + 1);
+    }
+
+    // tracks which drift like Doppler shifted harmonics, a few peaks are missing in every step
+    vector<vector<Peak<float>>> trackPeaks(size_t tracks) {
+        vector<vector<Peak<float>>> steps(BENCH_TRACE_STEPS);
+        srand(2);
+        for (size_t s = 0; s < BENCH_TRACE_STEPS; ++s) {
+            for (size_t t = 0; t < tracks; ++t) {
+                if (rand() % 20 == 0) {
+                    continue;
+                }
+                double position = 20 + 12.0 * t - 0.02 * (t % 4) * s + 0.6 * (rand() / (double) RAND_MAX - 0.5);
+                float height = 6 + 24 * (rand() / (float) RAND_MAX);
+                RealTime timestamp = RealTime::frame2RealTime(s * 2048, BENCH_SAMPLE_RATE);
+                steps[s].push_back(Peak<float>(height - 60, height, (size_t) lrint(position), position, timestamp));
+            }
+        }
+        return steps;
+    }
+
+    void benchTracer(size_t tracks, PeakTracer<float>::Mode mode) {
+        string name = string(mode == PeakTracer<float>::greedyMode ? "trace-greedy/" : "trace-assignment/") + std::to_string(tracks);
+        if (!selected(name)) return;
+
+        vector<vector<Peak<float>>> steps = trackPeaks(tracks);
+        PeakTracer<float> tracer;
+        size_t visited = 0;
+        double ns = measure(BENCH_TRACE_STEPS, [&]() {
+            tracer.initialise(MAX_BIN_JUMP, BROADEST_ALLOWED_INTERRUPTION, 0, PEAK_TRACING_HEIGHT_THRESHOLD, mode);
+        }, [&]() {
+            for (auto& peaks : steps) {
+                tracer.trace(peaks.data(), peaks.size(), true, true, [&visited](PeakHistory<float> &) { visited++; });
+            }
+        });
+        report(name, ns, tracks);
+    }
+
+    void benchAmplitudeFollower(size_t channels, size_t blockSize, bool envelope) {
+        string name = string(envelope ? "amplitude-envelope/" : "amplitude/") + std::to_string(channels) + "x" + std::to_string(blockSize);
+        if (!selected(name)) return;
+
+        size_t frames = BENCH_FRAMES;
+        vector<vector<float>> signals;
+        for (size_t c = 0; c < channels; ++c) {
+            signals.push_back(dopplerSignal(frames * blockSize, (unsigned) c + 1));
+        }
+        AmplitudeFollower follower(BENCH_SAMPLE_RATE);
+        follower.setParameter(ENVELOPE_FOLLOWER_ID, envelope ? 1 : 0);
+        if (!follower.initialise(channels, blockSize, blockSize)) {
+            std::cout << "# ERROR: can't initialise the plugin for " << name << "\n";
+            return;
+        }
+        vector<const float *> inputs(channels);
+        double ns = measure(frames, [&]() {
+            follower.reset();
+        }, [&]() {
+            for (size_t f = 0; f < frames; ++f) {
+                for (size_t c = 0; c < channels; ++c) {
+                    inputs[c] = signals[c].data() + f * blockSize;
+                }
+                follower.process(inputs.data(), RealTime::frame2RealTime(f * blockSize, BENCH_SAMPLE_RATE));
+            }
+        });
+        report(name, ns, channels * blockSize);
+    }
+
+    // reads the output of an earlier run, lines are benchmark;ns per bin;ns per step
+    bool readBaseline(const string & path) {
+        std::ifstream file(path);
+        if (!file) {
+            return false;
+        }
+        string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            string name, perBin, perStep;
+            if (line.empty() || line[0] == '#' || !std::getline(fields, name, ';') ||
+                !std::getline(fields, perBin, ';') || !std::getline(fields, perStep, ';')) {
+                continue;
+            }
+            options.baseline[name] = atof(perStep.c_str());
+        }
+        return true;
+    }
+
+    void printUsage() {
+        std::cerr << "usage: wunderwelt-bench [-t seconds] [-c baseline.csv] [-r tolerance] [filter]\n"
+                     "  -t  time spent in each benchmark (default " << BENCH_DEFAULT_TIME << " s)\n"
+                     "  -c  compare to the output of an earlier run, exit with 1 if a benchmark got slower\n"
+                     "  -r  relative slowdown which is tolerated (default " << BENCH_DEFAULT_TOLERANCE << ")\n"
+                     "  only the benchmarks whose name contains filter are run\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "-t" && i + 1 < argc) {
+            options.minTime = atof(argv[++i]);
+        } else if (argument == "-r" && i + 1 < argc) {
+            options.tolerance = atof(argv[++i]);
+        } else if (argument == "-c" && i + 1 < argc) {
+            if (!readBaseline(argv[++i])) {
+                std::cerr << "ERROR: can't read " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (argument[0] != '-' && options.filter.empty()) {
+            options.filter = argument;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // the warnings of the greedy tracer about dropped peaks would measure the terminal, not the tracer
+    std::streambuf *errors = std::cerr.rdbuf(nullptr);
+
+    std::cout << "# vector kernels: " << VectorKernels::implementation() << "\n";
+    std::cout << "# benchmark;ns/bin;ns/step" << (options.baseline.empty() ? "" : ";change") << std::endl;
+
+    for (size_t blockSize : {2048, 8192, 32768}) {
+        benchPeakFinder(blockSize);
+        benchMagnitudeAverage(blockSize);
+        benchProcess(blockSize);
+        for (size_t zoom = NO_ZOOM; zoom <= MAX_ZOOM; ++zoom) {
+            benchTimeDomainProcess(blockSize, zoom);
+        }
+    }
+    for (size_t tracks : {10, 100, 400}) {
+        benchTracer(tracks, PeakTracer<float>::greedyMode);
+        benchTracer(tracks, PeakTracer<float>::assignmentMode);
+    }
+    for (size_t channels : {1, 10}) {
+        for (size_t blockSize : {1024, 8192, 65536}) {
+            benchAmplitudeFollower(channels, blockSize, false);
+            benchAmplitudeFollower(channels, blockSize, true);
+        }
+    }
+    std::cerr.rdbuf(errors);
+    return options.slower ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+//
+//  DopplerScene.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "DopplerScene.hpp"
+#include "DopplerSpeedCalculator.hpp"
+
+#include <cmath>
+#include <random>
+
+std::vector<float> DopplerScene::generate(const Scene & scene) {
+    const double c = SPEED_OF_SOUND;
+    const double v = scene.speed / 3.6;
+    const double d = scene.distance;
+    std::mt19937 random(scene.seed);
+
+    std::vector<double> phases(scene.harmonics);
+    std::uniform_real_distribution<double> phase(0, 2 * M_PI);
+    double power = 0;
+    for (size_t k = 0; k < scene.harmonics; ++k) {
+        phases[k] = phase(random);
+        power += 0.5 / ((k + 1) * (k + 1));
+    }
+    std::normal_distribution<double> noise(0, sqrt(power) / d * pow(10, -scene.signalToNoiseRatio / 20));
+
+    std::vector<float> signal((size_t) (scene.duration * scene.sampleRate));
+    for (size_t n = 0; n < signal.size(); ++n) {
+        // the sound arriving at t left the source at t0 + u, with c (tau - u) = sqrt((v u)^2 + d^2) for tau = t - t0
+        // the root of this quadratic equation with u < tau is the retarded time
+        double tau = n / scene.sampleRate - scene.duration / 2;
+        double u = (c * c * tau - sqrt(c * c * v * v * tau * tau + (c * c - v * v) * d * d)) / (c * c - v * v);
+        double r = c * (tau - u);
+
+        double value = 0;
+        for (size_t k = 0; k < scene.harmonics; ++k) {
+            value += sin(2 * M_PI * (k + 1) * scene.frequency * u + phases[k]) / (k + 1);
+        }
+        signal[n] = (float) (value / r + noise(random));
+    }
+    return signal;
+}
@@ -0,0 +1,33 @@
+//
+//  DopplerScene.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef DopplerScene_hpp
+#define DopplerScene_hpp
+
+#include <stdio.h>
+#include <vector>
+
+// Synthesizes what a microphone records while a source passes by on a straight line, for testing the speed calculation
+// with known speeds. The source emits a fundamental with harmonics (amplitude 1/k for the k-th one, at 1 m distance);
+// the received signal is the emitted one at the retarded time, i.e. the time the sound left the source, which gives the
+// exact Doppler shift and the 1/r attenuation for every distance. White noise is added on top.
+namespace DopplerScene {
+
+    struct Scene {
+        float sampleRate; // Hz
+        double duration; // s, the source is closest to the microphone in the middle
+        double speed; // km/h
+        double distance; // m, distance between the microphone and the route at the closest approach
+        double frequency; // Hz, the fundamental emitted by the source
+        size_t harmonics; // number of partials including the fundamental
+        double signalToNoiseRatio; // dB, of the source at the closest approach relative to the noise
+        unsigned int seed; // of the noise and the phases of the harmonics
+    };
+
+    // returns the duration * sampleRate samples recorded at the microphone
+    std::vector<float> generate(const Scene & scene);
+}
+
+#endif /* DopplerScene_hpp */
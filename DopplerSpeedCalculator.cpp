@@ -7,6 +7,7 @@
 //
 
 #include "DopplerSpeedCalculator.hpp"
+#include "VectorKernels.hpp"
 #include <vamp-sdk/FFT.h>
 
 #include <iostream>
@@ -22,18 +23,38 @@ using std::complex;
 using std::stringstream;
 using Vamp::RealTime;
 
-// the channel we're gona use (plugin works only mono)
-#define CHANNEL 0
-
 // constructor of the calculator
 DopplerSpeedCalculator::DopplerSpeedCalculator (float inputSampleRate) :
     Vamp::Plugin(inputSampleRate),
     m_blocksProcessed(0),
     m_stepSize(0),
     m_blockSize(0),
+    m_fftSize(0),
+    m_paddingFactor(1),
+    m_analysedBins(0),
+    m_analysedValues(0),
     m_outputNumbers({}),
-    fftData(vector<vector<float>>()),
-    peakMatrix(vector<vector<Peak<float>*>>())
+    m_frequenciesOutput(0),
+    m_speedOutput(0),
+    m_peakDetectionTime(RealTime::zeroTime),
+    m_peakDetectionHeightThreshold(0),
+    m_peakTracingHeightThreshold(0),
+    m_upperThresholdBin(0),
+    m_maxBinJump(0),
+    m_broadestAllowedInterruption(0),
+    m_maxHistoryLength(0),
+    m_averagePower(false),
+    m_onlineOutput(false),
+    m_multiEvent(false),
+    m_minEventDuration(RealTime::zeroTime),
+    m_peakInterpolation(PeakFinder::noInterpolation),
+    m_peakDetector(PEAK_DETECTOR),
+    m_independentChannels(false),
+    m_newHistoryHeightThreshold(0),
+    m_decibelGain(0),
+    m_decibelFactor(0),
+    m_parallelChannels(true),
+    smoothing(SavitzkyGolay())
 {
     ParameterList parameters = this->getParameterDescriptors();
     for (auto it=parameters.begin(); it < parameters.end(); ++it) {
@@ -43,11 +64,6 @@ DopplerSpeedCalculator::DopplerSpeedCalculator (float inputSampleRate) :
 }
 
 DopplerSpeedCalculator::~DopplerSpeedCalculator () {
-    for (auto vec : peakMatrix) {
-        for (auto peak : vec) {
-            delete peak;
-        }
-    }
 }
 
 string DopplerSpeedCalculator::getIdentifier() const {
@@ -91,7 +107,7 @@ size_t DopplerSpeedCalculator::getMinChannelCount() const {
 }
 
 size_t DopplerSpeedCalculator::getMaxChannelCount() const {
-    return 1;
+    return MAX_CHANNEL_COUNT;
 }
 
 DopplerSpeedCalculator::ParameterList DopplerSpeedCalculator::getParameterDescriptors() const {
@@ -109,6 +125,18 @@ DopplerSpeedCalculator::ParameterList DopplerSpeedCalculator::getParameterDescri
     desc.valueNames = std::vector<std::string>{"off", "on"};
     plist.push_back(desc);
 
+    desc = ParameterDescriptor();
+    desc.identifier = SPECTRUM_DUMP_ID;
+    desc.name = "Spectrum Dump";
+    desc.description = "Set to 1 if you want the averaged spectra and their peaks to be written to spectrum.dump in the current working directory";
+    desc.defaultValue = 0;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = 1;
+    desc.valueNames = std::vector<std::string>{"off", "on"};
+    plist.push_back(desc);
+
     desc = ParameterDescriptor();
     desc.identifier = PEAK_DETECTION_TIME_ID;
     desc.name = "Peak Detection Time";
@@ -173,6 +201,55 @@ DopplerSpeedCalculator::ParameterList DopplerSpeedCalculator::getParameterDescri
     desc.unit = "bins";
     plist.push_back(desc);
 
+    desc = ParameterDescriptor();
+    desc.identifier = STREAMING_MODE_ID;
+    desc.name = "Streaming Mode";
+    desc.description = "Set to 1 to keep only the most recent peaks of every peak history, so that memory stays constant for inputs of any length. "
+    "The stable end and the dominating frequencies are then only searched within the kept peaks.";
+    desc.defaultValue = 0;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = 1;
+    desc.valueNames = std::vector<std::string>{"off", "on"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = ONLINE_OUTPUT_ID;
+    desc.name = "Online Output";
+    desc.description = "Set to 1 to output the speed of a source as soon as its peak history ends instead of only at the end of the input. "
+    "If no speed was output until then, it is calculated at the end as usual.";
+    desc.defaultValue = 0;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = 1;
+    desc.valueNames = std::vector<std::string>{"off", "on"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = MULTI_EVENT_ID;
+    desc.name = "Multiple Events";
+    desc.description = "Set to 1 to find every passing source in a long recording instead of only one. New peaks are then accepted during the whole input "
+    "if they are as high as the peak detection height threshold, and every peak history which ends with a stable begin and end is output as an event.";
+    desc.defaultValue = 0;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = 1;
+    desc.valueNames = std::vector<std::string>{"off", "on"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = MIN_EVENT_DURATION_ID;
+    desc.name = "Minimum Event Duration";
+    desc.description = "The minimum time between the stable begin and the stable end of a passing source in multiple events mode";
+    desc.defaultValue = MIN_EVENT_DURATION;
+    desc.minValue = 0;
+    desc.maxValue = 20;
+    desc.unit = "s";
+    plist.push_back(desc);
+
     desc = ParameterDescriptor();
     desc.identifier = MOVING_FFT_AVERAGE_WIDTH_ID;
     desc.name = "Width of moving average";
@@ -185,6 +262,111 @@ DopplerSpeedCalculator::ParameterList DopplerSpeedCalculator::getParameterDescri
     desc.unit = "steps";
     plist.push_back(desc);
 
+    desc = ParameterDescriptor();
+    desc.identifier = TRACING_MODE_ID;
+    desc.name = "Tracing Mode";
+    desc.description = "How the peaks of a step are assigned to the traced peak histories. 'greedy' compares each peak with the "
+    "neighbouring histories only, 'assignment' finds the assignment with the most matched histories and the smallest total "
+    "distance, which keeps close tracks of multiple sources apart.";
+    desc.defaultValue = TRACING_MODE;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = GREEDY_TRACING;
+    desc.maxValue = ASSIGNMENT_TRACING;
+    desc.valueNames = std::vector<std::string>{"greedy", "assignment"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = CHANNEL_MODE_ID;
+    desc.name = "Channel Mode";
+    desc.description = "How multiple channels (e.g. of a microphone array) are analysed. 'combined' sums up the powers of the "
+    "spectra of all channels, which improves the signal to noise ratio, 'independent' traces the peaks of each channel "
+    "separately and labels the features with the channel.";
+    desc.defaultValue = CHANNEL_MODE;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = COMBINED_CHANNELS;
+    desc.maxValue = INDEPENDENT_CHANNELS;
+    desc.valueNames = std::vector<std::string>{"combined", "independent"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = SMOOTHING_WINDOW_ID;
+    desc.name = "Smoothing Window";
+    desc.description = "The number of bins of the Savitzky-Golay filter which smooths the averaged spectrum before the peaks "
+    "are searched. 1 disables the smoothing.";
+    desc.defaultValue = SMOOTHING_WINDOW;
+    desc.minValue = 1;
+    desc.maxValue = 51;
+    desc.isQuantized = true;
+    desc.quantizeStep = 2.0;
+    desc.unit = "bins";
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = SMOOTHING_ORDER_ID;
+    desc.name = "Smoothing Order";
+    desc.description = "The order of the polynomials which are fitted by the Savitzky-Golay filter. Higher orders preserve "
+    "narrow peaks better but smooth less.";
+    desc.defaultValue = SMOOTHING_ORDER;
+    desc.minValue = 0;
+    desc.maxValue = 6;
+    desc.isQuantized = true;
+    desc.quantizeStep = 1.0;
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = AVERAGING_DOMAIN_ID;
+    desc.name = "Averaging Domain";
+    desc.description = "Whether the magnitudes or the powers (squared magnitudes) of the fft results are averaged. "
+    "Averaging the powers is the usual (Welch) estimate of the spectrum and saves a square root per bin.";
+    desc.defaultValue = AVERAGING_DOMAIN;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = MAGNITUDE_DOMAIN;
+    desc.maxValue = POWER_DOMAIN;
+    desc.valueNames = std::vector<std::string>{"magnitude", "power"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = PEAK_INTERPOLATION_ID;
+    desc.name = "Peak Interpolation";
+    desc.description = "How the frequency of a peak is estimated between the fft bins. 'quadratic-log' fits a parabola through the "
+    "dB values of the peak and its neighbours, which is a lot more accurate than the bin frequency and allows for smaller block sizes.";
+    desc.defaultValue = PEAK_INTERPOLATION;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = NO_INTERPOLATION;
+    desc.maxValue = QUADRATIC_LOG_INTERPOLATION;
+    desc.valueNames = std::vector<std::string>{"none", "quadratic-log"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = PEAK_DETECTOR_ID;
+    desc.name = "Peak Detector";
+    desc.description = "The algorithm which finds the peaks in the spectrum. 'threshold' needs the next valleys on both sides "
+    "to be lower than the peak by the height threshold, 'prominence' needs the prominence of the peak to reach the threshold "
+    "and 'top-k' works like 'threshold' but only keeps the highest peaks.";
+    desc.defaultValue = PEAK_DETECTOR;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = THRESHOLD_DETECTOR;
+    desc.maxValue = TOP_K_DETECTOR;
+    desc.valueNames = std::vector<std::string>{"threshold", "prominence", "top-k"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = TOP_K_PEAK_COUNT_ID;
+    desc.name = "Peak Count of Top-K Detector";
+    desc.description = "The maximum number of peaks per step which are kept by the top-k peak detector";
+    desc.defaultValue = TOP_K_PEAK_COUNT;
+    desc.minValue = 1;
+    desc.maxValue = 100;
+    desc.isQuantized = true;
+    desc.quantizeStep = 1.0;
+    desc.unit = "peaks";
+    plist.push_back(desc);
+
     return plist;
 }
 
@@ -248,210 +430,440 @@ DopplerSpeedCalculator::OutputList DopplerSpeedCalculator::getOutputDescriptors(
 }
 
 bool DopplerSpeedCalculator::initialise(size_t channels, size_t stepSize, size_t blockSize) {
+    // the host calculates the spectra from windows of blockSize samples without zero-padding
+    return initialiseAnalysis(channels, stepSize, blockSize, blockSize, blockSize / 2 + 1);
+}
+
+bool DopplerSpeedCalculator::initialiseAnalysis(size_t channels, size_t stepSize, size_t blockSize, size_t fftSize,
+                                                size_t spectrumSize) {
     if (channels < getMinChannelCount() ||
         channels > getMaxChannelCount()) return false;
 
+    // the host doesn't need to ask for the output descriptors before, so they are filled in here
+    getOutputDescriptors();
+    m_frequenciesOutput = m_outputNumbers["dominating-frequencies"];
+    m_speedOutput = m_outputNumbers["naive-speed-of-source"];
+
     m_stepSize = stepSize;
     m_blockSize = blockSize;
+    m_fftSize = fftSize;
+    m_paddingFactor = std::max<size_t>(fftSize / blockSize, 1);
+
+    m_peakDetectionTime = RealTime::fromSeconds(getParameter(PEAK_DETECTION_TIME_ID));
+    m_peakDetectionHeightThreshold = getParameter(PEAK_DETECTION_HEIGHT_THRESHOLD_ID);
+    m_peakTracingHeightThreshold = getParameter(PEAK_TRACING_HEIGHT_THRESHOLD_ID);
+    m_upperThresholdBin = std::min(getBinForFrequency(getParameter(UPPER_THRESHOLD_FREQUENCY_ID)), (spectrumSize - 1) / m_paddingFactor + 1);
+    m_maxBinJump = getParameter(MAX_BIN_JUMP_ID);
+    m_broadestAllowedInterruption = (size_t) getParameter(BROADEST_ALLOWED_INTERRUPTION_ID);
+    m_maxHistoryLength = getParameter(STREAMING_MODE_ID) ? STREAMING_HISTORY_LENGTH : 0;
+    m_averagePower = getParameter(AVERAGING_DOMAIN_ID) == POWER_DOMAIN;
+    m_onlineOutput = getParameter(ONLINE_OUTPUT_ID);
+    m_multiEvent = getParameter(MULTI_EVENT_ID);
+    m_minEventDuration = RealTime::fromSeconds(getParameter(MIN_EVENT_DURATION_ID));
+    // the spectrum is in dB, so a parabolic fit is the quadratic fit of the logarithm of the magnitudes
+    m_peakInterpolation = getParameter(PEAK_INTERPOLATION_ID) == QUADRATIC_LOG_INTERPOLATION ?
+        PeakFinder::parabolicInterpolation : PeakFinder::noInterpolation;
+    m_peakDetector = (int) getParameter(PEAK_DETECTOR_ID);
+    topKDetector.k = (size_t) getParameter(TOP_K_PEAK_COUNT_ID);
+    m_newHistoryHeightThreshold = m_multiEvent ? m_peakDetectionHeightThreshold : 0;
+    m_independentChannels = channels > 1 && getParameter(CHANNEL_MODE_ID) == INDEPENDENT_CHANNELS;
+
+    smoothing.initialise((size_t) getParameter(SMOOTHING_WINDOW_ID) / 2, (size_t) getParameter(SMOOTHING_ORDER_ID));
+
+    // only the bins below the upper threshold are searched for peaks, the smoothing needs half a window more of them
+    // (with zero-padding, the values up to half a bin after the last searched one refine its position)
+    m_analysedBins = std::min(m_upperThresholdBin + smoothing.getWindowLength() / 2, (spectrumSize - 1) / m_paddingFactor + 1);
+    m_analysedValues = std::min(m_analysedBins * m_paddingFactor, spectrumSize);
+
+    size_t averageWidth = std::max<size_t>(getParameter(MOVING_FFT_AVERAGE_WIDTH_ID), 1);
+    size_t combinedChannels = m_independentChannels ? 1 : channels;
+    if (m_averagePower) {
+        m_decibelGain = 4.0f / (1.0f * m_blockSize * m_blockSize * averageWidth) / combinedChannels;
+        m_decibelFactor = 10;
+    } else {
+        // the magnitude of combined channels is the square root of the summed powers
+        m_decibelGain = 2.0f / (m_blockSize * averageWidth) / std::sqrt((float) combinedChannels);
+        m_decibelFactor = 20;
+    }
 
+    m_channelStates.clear();
+    m_channelStates.resize(m_independentChannels ? channels : 1);
+    for (size_t c = 0; c < m_channelStates.size(); ++c) {
+        ChannelState & state = m_channelStates[c];
+        state.channel = c;
+        state.channelCount = combinedChannels;
+
+        // the analysed values of the spectrum start at 0 (dc), the bins are every m_paddingFactor-th value
+        state.fftAverage.initialise(averageWidth, m_analysedValues);
+
+        // there can't be more peaks than every second bin
+        state.magnitudes.assign(m_analysedValues, 0);
+        state.powers.assign(combinedChannels > 1 ? m_analysedValues : 0, 0);
+        state.averagedData.assign(m_analysedValues, 0);
+        state.binData.assign(m_paddingFactor > 1 ? m_analysedBins : 0, 0);
+        state.smoothedData.assign(smoothing.isEnabled() ? m_analysedBins : 0, 0);
+        state.peaks.assign(m_upperThresholdBin / 2 + 1, Peak<float>());
+
+        state.peakTracer.initialise(m_maxBinJump, m_broadestAllowedInterruption, m_maxHistoryLength, m_newHistoryHeightThreshold,
+                                    getParameter(TRACING_MODE_ID) == ASSIGNMENT_TRACING ? PeakTracer<float>::assignmentMode : PeakTracer<float>::greedyMode);
+        state.eventSpeeds.clear();
+        state.eventFrequencies.clear();
+        state.peakCount = 0;
+        state.reportedSpeeds = 0;
+    }
+
+    // many independent channels are analysed in parallel, the calling thread takes part in the work
+    size_t threads = 0;
+    if (m_parallelChannels && m_channelStates.size() >= PARALLEL_CHANNEL_MINIMUM) {
+        threads = std::min<size_t>(m_channelStates.size(), std::max<size_t>(std::thread::hardware_concurrency(), 1)) - 1;
+    }
+    m_workers.start(threads);
+
+    csvWriter.close();
     if (this->getParameter(DEBUG_CSV_FILES)) {
-        // open the debug csv file for writing
-        csvfile = std::ofstream("fft.csv");
-        if (csvfile.fail()) {
+        // open the debug csv file for writing, the header has the frequencies of the bins
+        stringstream header;
+        for (size_t i = 0; i < m_analysedBins; ++i) {
+            float freq = getFrequencyForBin(i);
+            header << freq << " Hz;";
+        }
+        if (!csvWriter.open("fft.csv", header.str(), m_analysedBins)) {
             std::cerr << "WARNING: could not open debug csv file\n";
         }
-    } else {
-        csvfile = std::ofstream(0);
     }
 
-    for (size_t i = 1; i <= m_blockSize / 2; ++i) {
-        float freq = getFrequencyForBin(i);
-        csvfile<< freq << " Hz;";
+    spectrumDump.close();
+    if (this->getParameter(SPECTRUM_DUMP_ID)) {
+        // the averaged spectra are dumped before they are smoothed, so they can be analysed again with any parameters
+        SpectrumDumpHeader header = SpectrumDumpHeader();
+        header.sampleRate = m_inputSampleRate;
+        header.blockSize = (uint32_t) m_blockSize;
+        header.stepSize = (uint32_t) m_stepSize;
+        header.fftSize = (uint32_t) m_fftSize;
+        header.paddingFactor = (uint32_t) m_paddingFactor;
+        header.frameSize = (uint32_t) m_analysedValues;
+        header.spectraPerStep = (uint32_t) m_channelStates.size();
+        if (!spectrumDump.open("spectrum.dump", header, m_parameterValues)) {
+            std::cerr << "WARNING: could not open spectrum dump\n";
+        }
     }
-    csvfile << "\n";
 
     return true;
 }
 
 void DopplerSpeedCalculator::reset() {
     m_blocksProcessed = 0;
+    for (auto& state : m_channelStates) {
+        state.fftAverage.reset();
+        state.peakTracer.reset();
+        state.reportedSpeeds = 0;
+        state.eventSpeeds.clear();
+        state.eventFrequencies.clear();
+    }
 }
 
 DopplerSpeedCalculator::FeatureSet DopplerSpeedCalculator::process(const float *const *inputBuffers, RealTime timestamp) {
-    const float *const inputBuffer = inputBuffers[CHANNEL];
-    vector<float> currentData = vector<float>();
-    bool peakDectectionTime = timestamp < RealTime().fromSeconds(getParameter(PEAK_DETECTION_TIME_ID));
-    int movingFFTAverageWidth = getParameter(MOVING_FFT_AVERAGE_WIDTH_ID);
-
-    // 0 Hz term, equivalent to the average of all the samples in the window
-    // complex<float> dcTerm = complex<float>(inputBuffer[0], inputBuffer[1]);
-
-    // calculate the magnitudes and store them in fftData
-    for (size_t i = 2; i < m_blockSize + 2; i+=2) {
-        float curMag = std::abs(std::complex<float>(inputBuffer[i], inputBuffer[i+1]));
-        currentData.push_back(curMag);
+    if (m_channelStates.size() == 1) {
+        calculateSpectrum(m_channelStates[0], inputBuffers);
+        analyse(m_channelStates[0], timestamp);
+    } else {
+        auto job = [this, inputBuffers, timestamp](size_t c) {
+            calculateSpectrum(m_channelStates[c], inputBuffers);
+            analyse(m_channelStates[c], timestamp);
+        };
+        m_workers.run(m_channelStates.size(), job);
     }
-    fftData.emplace_back(std::move(currentData));
-
-    if (fftData.size() == movingFFTAverageWidth) {
-        // sum up fftData to later calculate the average
-        vector<float> summedData = vector<float>(m_blockSize / 2);
-        for (auto fft : fftData) {
-            for (size_t i = 0; i < fft.size(); i++) {
-                summedData[i] += fft[i];
+
+    if (spectrumDump.isOpen()) {
+        for (auto& state : m_channelStates) {
+            if (state.fftAverage.isFull()) {
+                spectrumDump.addFrame(state.channel, timestamp, state.averagedData.data(), state.peaks.data(), state.peakCount);
             }
         }
+    }
 
-        // calc the average, normalize the magnitudes and store them again for peak finding
-        vector<float> averagedData;
-        for (auto val : summedData) {
-            float avgMag = val / movingFFTAverageWidth;
-            float avgNormMag = normalizeMagnitude(avgMag);
-            csvfile << avgNormMag << ";";
-            averagedData.push_back(avgNormMag);
-        }
-        csvfile << "\n";
+    m_blocksProcessed++;
+    return getOnlineFeatures();
+}
 
-        // find all peaks, where the threshold is dependent on whether we are before or after PEAK_DETECTION_TIME
-        auto beginIt = averagedData.begin();
-        auto endit = beginIt + getBinForFrequency(getParameter(UPPER_THRESHOLD_FREQUENCY_ID));
-        float heightThreshold = peakDectectionTime ? getParameter(PEAK_DETECTION_HEIGHT_THRESHOLD_ID) : getParameter(PEAK_TRACING_HEIGHT_THRESHOLD_ID);
-        std::vector<Peak<float>*> peaks = PeakFinder::findPeaksThreshold(beginIt, endit, heightThreshold, timestamp);
-        this->peakMatrix.push_back(peaks);
+bool DopplerSpeedCalculator::initialiseSpectrumReplay(const SpectrumDumpHeader & header) {
+    // the dumped spectra only have the values which were analysed when they were dumped, higher ones are cut off
+    if (!initialiseAnalysis(header.spectraPerStep, header.stepSize, header.blockSize, header.fftSize, header.frameSize)) {
+        return false;
+    }
+    return m_channelStates.size() == header.spectraPerStep;
+}
 
-        // trace the peaks
-        this->tracePeaks(peaks, peakDectectionTime);
+DopplerSpeedCalculator::FeatureSet DopplerSpeedCalculator::processSpectrum(const float *const *averagedSpectra, RealTime timestamp) {
+    for (size_t c = 0; c < m_channelStates.size(); ++c) {
+        ChannelState & state = m_channelStates[c];
+        std::copy(averagedSpectra[c], averagedSpectra[c] + state.averagedData.size(), state.averagedData.begin());
+    }
 
-        // remove the oldest fft result from the fftData vector to achieve a moving average
-        fftData.erase(fftData.begin());
+    if (m_channelStates.size() == 1) {
+        analyseSpectrum(m_channelStates[0], timestamp);
+    } else {
+        auto job = [this, timestamp](size_t c) {
+            analyseSpectrum(m_channelStates[c], timestamp);
+        };
+        m_workers.run(m_channelStates.size(), job);
     }
 
-    FeatureSet fs;
     m_blocksProcessed++;
+    return getOnlineFeatures();
+}
+
+DopplerSpeedCalculator::FeatureSet DopplerSpeedCalculator::getOnlineFeatures() {
+    FeatureSet fs;
+    if (m_onlineOutput) {
+        for (auto& state : m_channelStates) {
+            if (state.eventSpeeds.empty()) {
+                continue;
+            }
+            state.reportedSpeeds += state.eventSpeeds.size();
+            FeatureList & speeds = fs[m_speedOutput];
+            speeds.insert(speeds.end(), state.eventSpeeds.begin(), state.eventSpeeds.end());
+            state.eventSpeeds.clear();
+            if (!state.eventFrequencies.empty()) {
+                FeatureList & frequencies = fs[m_frequenciesOutput];
+                frequencies.insert(frequencies.end(), state.eventFrequencies.begin(), state.eventFrequencies.end());
+                state.eventFrequencies.clear();
+            }
+        }
+    }
     return fs;
 }
 
-void DopplerSpeedCalculator::tracePeaks(const std::vector<Peak<float> *> &peaks, bool allowNew) {
-    auto currentHist = peakHistories.begin();
-    auto lastHistory = currentHist;
-
-    double currentHistoryPosition = 0;
-    double lastHistoryPosition = currentHist != peakHistories.end() ? currentHist->getLast()->interpolatedPosition : std::numeric_limits<double>::min();;;
-
-    double currentDiff;
-    double lastDiff;
-
-    bool peakDone = false;
-    bool addedPeakToLast = false;
-    bool addedPeakToCurrent = false;
-
-    // parameter values
-    auto maxBinJump = getParameter(MAX_BIN_JUMP_ID);
-    size_t broadestAllowedInterruption = (size_t) getParameter(BROADEST_ALLOWED_INTERRUPTION_ID);
-
-    std::vector<PeakHistory<float>> toInsert;
-
-    // iterate through the peaks and PeakHistories at the same time
-    // invariant: both vectors are sorted by the position ascendingly
-    for (auto peak : peaks) {
-        peakDone = false;
-        while (currentHist != peakHistories.end() && !peakDone) {
-            currentHistoryPosition = currentHist->getLast()->interpolatedPosition;
-            lastDiff = fabs(peak->interpolatedPosition - lastHistoryPosition);
-            currentDiff = fabs(peak->interpolatedPosition - currentHistoryPosition);
-
-            // if the peak is still between the two PeakHistories, try to associate it with one
-            if (peak->interpolatedPosition < currentHistoryPosition) {
-                if (lastDiff <= maxBinJump || currentDiff <= maxBinJump) {  // the peak is near enough to one of the already existing peaks
-                    if (lastDiff < currentDiff) {
-                        if (peak->interpolatedPosition > lastHistoryPosition + 1) {
-                            std::cerr << "Warning: " << peak->timestamp.sec*1000 + peak->timestamp.msec() << ": " << peak->interpolatedPosition << " vs. " << lastHistoryPosition << "\n";
-                        } else {
-                            lastHistory->addPeak(peak);
-                            addedPeakToLast = true;
-                        }
-                    } else {
-                        currentHist->addPeak(peak);
-                        addedPeakToCurrent = true;
-                    }
-                } else if (allowNew) {          // the peak is not near enough, so insert it if allowNew is set
-                    toInsert.emplace_back(peak, broadestAllowedInterruption);
-                } // else ignore peak
-                peakDone = true;
-            } else { // go one step further in the vector of PeakHistories
-                if (!addedPeakToLast) {
-                    lastHistory->noPeak();
-                }
-                addedPeakToLast = addedPeakToCurrent;
-                addedPeakToCurrent = false;
+void DopplerSpeedCalculator::calculateSpectrum(ChannelState & state, const float *const *inputBuffers) {
+    // calculate the magnitudes or powers of all bins (including the dc term)
+    const float *const inputBuffer = inputBuffers[state.channel];
+    if (state.channelCount == 1) {
+        if (m_averagePower) {
+            VectorKernels::squaredMagnitudes(inputBuffer, state.magnitudes.data(), state.magnitudes.size());
+        } else {
+            VectorKernels::magnitudes(inputBuffer, state.magnitudes.data(), state.magnitudes.size());
+        }
+        return;
+    }
+
+    // sum up the powers of all channels, the division by the number of channels is part of the decibel gain
+    VectorKernels::squaredMagnitudes(inputBuffer, state.magnitudes.data(), state.magnitudes.size());
+    for (size_t c = state.channel + 1; c < state.channel + state.channelCount; ++c) {
+        VectorKernels::squaredMagnitudes(inputBuffers[c], state.powers.data(), state.powers.size());
+        VectorKernels::multiplyAdd(state.powers.data(), state.magnitudes.data(), state.magnitudes.size(), 1.0f);
+    }
+    if (!m_averagePower) {
+        VectorKernels::squareRoots(state.magnitudes.data(), state.magnitudes.data(), state.magnitudes.size());
+    }
+}
 
-                lastHistoryPosition = currentHistoryPosition;
-                lastHistory = currentHist;
-                ++currentHist;
+void DopplerSpeedCalculator::refinePeakPositions(ChannelState & state, size_t peakCount) {
+    const float *padded = state.averagedData.data();
+    size_t last = state.averagedData.size() - 1;
+    for (size_t p = 0; p < peakCount; ++p) {
+        Peak<float> & peak = state.peaks[p];
+
+        // the maximum of the padded spectrum within half a bin of the peak
+        size_t center = peak.position * m_paddingFactor;
+        size_t begin = center >= m_paddingFactor / 2 ? center - m_paddingFactor / 2 : 0;
+        size_t end = std::min(center + m_paddingFactor / 2, last);
+        size_t maximum = center;
+        for (size_t i = begin; i <= end; ++i) {
+            if (padded[i] > padded[maximum]) {
+                maximum = i;
             }
         }
 
-        if (!peakDone && allowNew) {
-            toInsert.emplace_back(peak, broadestAllowedInterruption);
+        double offset = maximum > 0 && maximum < last ?
+            PeakFinder::interpolationOffset(padded[maximum - 1], padded[maximum], padded[maximum + 1], m_peakInterpolation) : 0;
+        peak.interpolatedPosition = (maximum + offset) / m_paddingFactor;
+    }
+}
+
+void DopplerSpeedCalculator::analyse(ChannelState & state, RealTime timestamp) {
+    state.fftAverage.add(state.magnitudes.data());
+    if (!state.fftAverage.isFull()) {
+        return;
+    }
+
+    // calc the average and normalize it in one go, see normalizeMagnitude and normalizePower
+    VectorKernels::decibels(state.fftAverage.getSums(), state.averagedData.data(), state.averagedData.size(), m_decibelGain, m_decibelFactor);
+
+    analyseSpectrum(state, timestamp);
+}
+
+void DopplerSpeedCalculator::analyseSpectrum(ChannelState & state, RealTime timestamp) {
+    // with multiple events, peaks are detected during the whole input but only high enough peaks start new histories
+    bool peakDectectionTime = !m_multiEvent && timestamp < m_peakDetectionTime;
+
+    // a zero-padded spectrum has the values of the bins at every m_paddingFactor-th position
+    const float *spectrum = state.averagedData.data();
+    size_t binCount = m_analysedBins;
+    if (m_paddingFactor > 1) {
+        for (size_t i = 0; i < binCount; ++i) {
+            state.binData[i] = state.averagedData[i * m_paddingFactor];
         }
+        spectrum = state.binData.data();
+    }
+
+    // smooth the spectrum if requested
+    if (smoothing.isEnabled()) {
+        smoothing.apply(spectrum, state.smoothedData.data(), binCount);
+        spectrum = state.smoothedData.data();
+    }
+
+    // only the spectrum of the first channel is written to the debug csv file
+    if (state.channel == 0 && csvWriter.isOpen()) {
+        csvWriter.push(spectrum);
+    }
+
+    // find all peaks, where the threshold is dependent on whether we are before or after PEAK_DETECTION_TIME
+    float heightThreshold = peakDectectionTime ? m_peakDetectionHeightThreshold : m_peakTracingHeightThreshold;
+    size_t peakCount;
+    switch (m_peakDetector) {
+        case PROMINENCE_DETECTOR:
+            peakCount = findPeaks(state, state.prominenceDetector, spectrum, heightThreshold, timestamp);
+            break;
+        case TOP_K_DETECTOR:
+            peakCount = findPeaks(state, topKDetector, spectrum, heightThreshold, timestamp);
+            break;
+        default:
+            peakCount = findPeaks(state, thresholdDetector, spectrum, heightThreshold, timestamp);
+            break;
+    }
+
+    if (m_paddingFactor > 1) {
+        refinePeakPositions(state, peakCount);
     }
+    state.peakCount = peakCount;
 
-    // kill remove peak histories which are not alive
-    peakHistories.erase(std::remove_if(peakHistories.begin(), peakHistories.end(),
-                                       [](PeakHistory<float> & elem) -> bool { return !elem.isAlive(); }),
-                        peakHistories.end());
+    // trace the peaks
+    this->tracePeaks(state, peakCount, peakDectectionTime || m_multiEvent);
+}
 
-    // insert new peaks into histories and keep them sorted
-    peakHistories.insert(peakHistories.end(), toInsert.begin(), toInsert.end());
-    std::sort(peakHistories.begin(), peakHistories.end(),
-              [](const PeakHistory<float> & a, const PeakHistory<float> & b) -> bool {
-        return a.getLast()->interpolatedPosition < b.getLast()->interpolatedPosition;
+void DopplerSpeedCalculator::tracePeaks(ChannelState & state, size_t peakCount, bool allowNew) {
+    // histories which are not alive any more are removed after the step
+    // in online or multiple events mode, histories which just ended are reported before if they belong to a passing source
+    // with multiple events, ended histories are never kept as the next source may follow
+    bool report = m_onlineOutput || m_multiEvent;
+    state.peakTracer.trace(state.peaks.data(), peakCount, allowNew, !m_multiEvent, [this, &state, report](PeakHistory<float> & history) {
+        if (report && !history.isReported() && history.hasEnded()) {
+            reportEvent(state, history);
+        }
     });
 }
 
 DopplerSpeedCalculator::FeatureSet DopplerSpeedCalculator::getRemainingFeatures() {
     // put the feature into the feature set
     FeatureSet fs;
+    FeatureList & speeds = fs[m_speedOutput];
+    FeatureList & frequencies = fs[m_frequenciesOutput];
+
+    for (auto& state : m_channelStates) {
+        PeakTracer<float> & peakTracer = state.peakTracer;
+
+        if (m_multiEvent) {
+            // histories which did not end until now are events too
+            for (size_t i = 0; i < peakTracer.size(); ++i) {
+                if (!peakTracer[i].isReported()) {
+                    reportEvent(state, peakTracer[i]);
+                }
+            }
+            speeds.insert(speeds.end(), state.eventSpeeds.begin(), state.eventSpeeds.end());
+            frequencies.insert(frequencies.end(), state.eventFrequencies.begin(), state.eventFrequencies.end());
+            state.eventSpeeds.clear();
+            state.eventFrequencies.clear();
+            continue;
+        }
 
-    if (peakHistories.empty()) {
-        return fs;
+        if (peakTracer.size() == 0) {
+            continue;
+        }
+
+        // sort peaks by total height
+        vector<PeakHistory<float>*> peakHistories;
+        for (size_t i = 0; i < peakTracer.size(); ++i) {
+            peakHistories.push_back(&peakTracer[i]);
+        }
+        std::sort(peakHistories.begin(), peakHistories.end(),
+                  [](const PeakHistory<float> *a, const PeakHistory<float> *b) -> bool {
+                      return a->getTotalPeakHeight() > b->getTotalPeakHeight();
+                  });
+
+        // output the dominating frequencies feature
+        auto firstHist = peakHistories.begin();
+        getDominatingFrequencies(state, **firstHist, frequencies);
+
+        // the speed of the strongest history, unless speeds were already output while processing
+        Feature speed;
+        while (state.reportedSpeeds == 0 && firstHist != peakHistories.end()) {
+            if (getSpeedFeature(**firstHist, speed)) {
+                setChannelLabel(state, speed);
+                speeds.push_back(speed);
+                break;
+            }
+            ++firstHist;
+        }
     }
 
-    // sort peaks by total height
-    std::sort(peakHistories.begin(), peakHistories.end(),
-              [](const PeakHistory<float> & a, const PeakHistory<float> & b) -> bool {
-                  return a.getTotalPeakHeight() > b.getTotalPeakHeight();
-              });
+    return fs;
+}
+
+bool DopplerSpeedCalculator::getSpeedFeature(PeakHistory<float> & history, Feature & speed) {
+    auto approaching = history.getStableBegin();
+    auto leaving = history.getStableEnd();
+    if (!approaching || !leaving) {
+        return false;
+    }
+
+    speed.hasDuration = true;
+    speed.hasTimestamp = true;
+    speed.timestamp = approaching->timestamp;
+    speed.duration = leaving->timestamp - approaching->timestamp;
+    speed.values.clear();
+    speed.values.push_back(dopplerSpeedMovingSource(approaching->interpolatedPosition, leaving->interpolatedPosition));
+    return true;
+}
 
-    // output the dominating frequencies feature
+void DopplerSpeedCalculator::getDominatingFrequencies(const ChannelState & state, const PeakHistory<float> & history,
+                                                      FeatureList & frequencies) {
     Feature dominatingFrequencies;
     dominatingFrequencies.hasTimestamp = true;
     dominatingFrequencies.hasDuration = true;
-    auto firstHist = this->peakHistories.begin();
+    setChannelLabel(state, dominatingFrequencies);
     vector<pair<RealTime, double>> positions;
-    firstHist->getInterpolatedPositionHistory(positions);
+    history.getInterpolatedPositionHistory(positions);
     for (auto pos : positions) {
         dominatingFrequencies.duration = RealTime().fromSeconds(m_blockSize / m_inputSampleRate * (1.0 * m_stepSize / m_blockSize));
         dominatingFrequencies.timestamp = pos.first;
         dominatingFrequencies.values = vector<float>(1, getFrequencyForBin(pos.second));
-        fs[m_outputNumbers["dominating-frequencies"]].push_back(dominatingFrequencies);
+        frequencies.push_back(dominatingFrequencies);
     }
+}
 
+bool DopplerSpeedCalculator::reportEvent(ChannelState & state, PeakHistory<float> & history) {
+    // only sources which passed by, i.e. whose frequency fell, are events
     Feature speed;
-    while (firstHist != peakHistories.end()) {
-        auto approaching = firstHist->getStableBegin();
-        auto leaving = firstHist->getStableEnd();
-        if (approaching && leaving) {
-            speed.hasDuration = true;
-            speed.hasTimestamp = true;
-            speed.timestamp = approaching->timestamp;
-            speed.duration = leaving->timestamp - approaching->timestamp;
-            speed.values.push_back(dopplerSpeedMovingSource(approaching->interpolatedPosition, leaving->interpolatedPosition));
-            fs[m_outputNumbers["naive-speed-of-source"]].push_back(speed);
-            break;
-        }
-        ++firstHist;
+    if (!getSpeedFeature(history, speed) || speed.values[0] <= 0) {
+        return false;
+    }
+    if (m_multiEvent && speed.duration < m_minEventDuration) {
+        return false;
     }
 
-    return fs;
+    history.setReported();
+    setChannelLabel(state, speed);
+    state.eventSpeeds.push_back(speed);
+    if (m_multiEvent) {
+        getDominatingFrequencies(state, history, state.eventFrequencies);
+    }
+    return true;
+}
+
+void DopplerSpeedCalculator::setChannelLabel(const ChannelState & state, Feature & feature) {
+    if (m_independentChannels) {
+        std::stringstream label;
+        label << "channel " << state.channel + 1;
+        feature.label = label.str();
+    }
 }
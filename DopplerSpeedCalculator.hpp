@@ -12,14 +12,20 @@
 #include <stdio.h>
 #include <vamp-sdk/Plugin.h>
 #include <iostream>
-#include <fstream>
 #include <complex>
 
 #include "PeakFinder.hpp"
 #include "PeakHistory.hpp"
+#include "PeakTracer.hpp"
+#include "MovingAverage.hpp"
+#include "SavitzkyGolay.hpp"
+#include "WorkerPool.hpp"
+#include "AsyncCsvWriter.hpp"
+#include "SpectrumDump.hpp"
 
 // Parameter Identifiers
 #define DEBUG_CSV_FILES "write-debug-csv"
+#define SPECTRUM_DUMP_ID "write-spectrum-dump"
 #define PEAK_DETECTION_TIME_ID "peak-detection-time"
 #define PEAK_DETECTION_HEIGHT_THRESHOLD_ID "peak-detection-height-threshold"
 #define PEAK_TRACING_HEIGHT_THRESHOLD_ID "peak-tracing-height-threshold"
@@ -27,6 +33,18 @@
 #define MAX_BIN_JUMP_ID "max-bin-jump"
 #define BROADEST_ALLOWED_INTERRUPTION_ID "broadest-interruption"
 #define MOVING_FFT_AVERAGE_WIDTH_ID "moving-fft-average-width"
+#define STREAMING_MODE_ID "streaming-mode"
+#define ONLINE_OUTPUT_ID "online-output"
+#define MULTI_EVENT_ID "multi-event"
+#define MIN_EVENT_DURATION_ID "min-event-duration"
+#define AVERAGING_DOMAIN_ID "averaging-domain"
+#define PEAK_INTERPOLATION_ID "peak-interpolation"
+#define PEAK_DETECTOR_ID "peak-detector"
+#define TOP_K_PEAK_COUNT_ID "top-k-peak-count"
+#define SMOOTHING_WINDOW_ID "smoothing-window"
+#define SMOOTHING_ORDER_ID "smoothing-order"
+#define TRACING_MODE_ID "tracing-mode"
+#define CHANNEL_MODE_ID "channel-mode"
 
 // Parameter Default Values
 #define PEAK_DETECTION_TIME 1.5 // s
@@ -36,9 +54,42 @@
 #define MAX_BIN_JUMP 5 // bins
 #define BROADEST_ALLOWED_INTERRUPTION 10 // steps
 #define MOVING_FFT_AVERAGE_WIDTH 4
+#define MIN_EVENT_DURATION 2.0 // s
+#define AVERAGING_DOMAIN MAGNITUDE_DOMAIN
+#define PEAK_INTERPOLATION NO_INTERPOLATION
+#define PEAK_DETECTOR THRESHOLD_DETECTOR
+#define TOP_K_PEAK_COUNT 10 // peaks
+#define SMOOTHING_WINDOW 1 // bins, 1 means no smoothing
+#define SMOOTHING_ORDER 2
+#define TRACING_MODE GREEDY_TRACING
+#define CHANNEL_MODE COMBINED_CHANNELS
+
+// Values of the averaging domain parameter
+#define MAGNITUDE_DOMAIN 0
+#define POWER_DOMAIN 1
+
+// Values of the peak interpolation parameter
+#define NO_INTERPOLATION 0
+#define QUADRATIC_LOG_INTERPOLATION 1
+
+// Values of the peak detector parameter
+#define THRESHOLD_DETECTOR 0
+#define PROMINENCE_DETECTOR 1
+#define TOP_K_DETECTOR 2
+
+// Values of the tracing mode parameter
+#define GREEDY_TRACING 0
+#define ASSIGNMENT_TRACING 1
+
+// Values of the channel mode parameter
+#define COMBINED_CHANNELS 0
+#define INDEPENDENT_CHANNELS 1
 
 // Other constants
 #define SPEED_OF_SOUND 343
+#define STREAMING_HISTORY_LENGTH 256 // steps, peaks kept per peak history in streaming mode
+#define MAX_CHANNEL_COUNT 32
+#define PARALLEL_CHANNEL_MINIMUM 4 // independent channels are analysed on multiple threads from this number of channels on
 
 using std::string;
 using PeakFinder::Peak;
@@ -82,11 +133,29 @@ public:
     bool initialise(size_t channels, size_t stepSize, size_t blockSize);
     void reset();
 
+    /// In streaming mode, process doesn't allocate memory once every peak history kept its maximum number of peaks,
+    /// except for the features of the events it reports. Otherwise the histories keep all their peaks and grow with
+    /// the input (amortised, the storage grows in chunks).
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
     FeatureSet getRemainingFeatures();
 
+    /// initialises the plugin for analysing the averaged spectra of a spectrum dump again, e.g. with other parameters
+    /// the parameters which shape the averaged spectra (like the width of the average) have no effect
+    /// if the dump has more than one spectrum per step, the channel mode must be set to independent channels
+    bool initialiseSpectrumReplay(const SpectrumDumpHeader & header);
+
+    /// whether independent channels are analysed on threads of their own (from PARALLEL_CHANNEL_MINIMUM channels on),
+    /// takes effect with the next initialise; callers which run many instances in parallel themselves switch it off
+    void setParallelChannels(bool parallel) {
+        this->m_parallelChannels = parallel;
+    }
+
+    /// analyses the averaged spectra of a step (one per channel state, as in the frames of a spectrum dump)
+    /// instead of calculating them from the input, the features are the same as the ones of process
+    FeatureSet processSpectrum(const float *const *averagedSpectra, Vamp::RealTime timestamp);
+
     /// calculates the center frequency of a bin (i.e. the index of the bin or an interpolated value inbetween)
     template<typename T> float getFrequencyForBin(T bin) {
         return (1.0f * this->m_inputSampleRate * bin) / this->m_blockSize;
@@ -110,26 +179,159 @@ public:
         return 20 * log10(mag);
     };
 
+    /// Calculates the normalized magnitude in dB given the squared magnitude (power) as a number
+    template<typename T> float normalizePower(T power) {
+        auto pow = power * 4 / (1.0 * this->m_blockSize * this->m_blockSize);
+        return 10 * log10(pow);
+    };
+
+protected:
+    // initialises the analysis of spectra of fftSize values, which are calculated from windows of blockSize samples
+    // (fftSize is a multiple of blockSize if the windows are zero-padded, the peaks are still found in bins of blockSize)
+    // the spectra passed to process only contain the first spectrumSize complex values, at most fftSize / 2 + 1
+    bool initialiseAnalysis(size_t channels, size_t stepSize, size_t blockSize, size_t fftSize, size_t spectrumSize);
+
+    // number of complex values at the beginning of each spectrum which are analysed, the other ones are never read
+    size_t getAnalysedValues() const {
+        return this->m_analysedValues;
+    }
 
 private:
     size_t m_blocksProcessed;
     size_t m_stepSize;
     size_t m_blockSize;
+    size_t m_fftSize;
+
+    // number of values of the (zero-padded) spectrum per bin, i.e. m_fftSize / m_blockSize
+    size_t m_paddingFactor;
+
+    // number of bins and values (including the padded ones) at the beginning of the spectrum which are analysed,
+    // all other ones are above the upper threshold frequency and never looked at
+    size_t m_analysedBins;
+    size_t m_analysedValues;
     mutable std::map<std::string, int> m_outputNumbers;
+
+    // the numbers of the outputs written while processing, looked up once in initialise
+    int m_frequenciesOutput;
+    int m_speedOutput;
     std::map<std::string, float> m_parameterValues;
 
-    // contains the last few fft results which get averaged before finding peaks
-    vector<vector<float>> fftData;
+    // parameter values which are needed on every step, read once in initialise
+    RealTime m_peakDetectionTime;
+    float m_peakDetectionHeightThreshold;
+    float m_peakTracingHeightThreshold;
+    size_t m_upperThresholdBin;
+    float m_maxBinJump;
+    size_t m_broadestAllowedInterruption;
+    size_t m_maxHistoryLength;
+    bool m_averagePower;
+    bool m_onlineOutput;
+    bool m_multiEvent;
+    RealTime m_minEventDuration;
+    PeakFinder::Interpolation m_peakInterpolation;
+    int m_peakDetector;
+    bool m_independentChannels;
+
+    // peaks must be at least that high to start a new peak history
+    float m_newHistoryHeightThreshold;
+
+    // the averaged spectrum is converted to dB by m_decibelFactor * log10(m_decibelGain * sum)
+    // see normalizeMagnitude and normalizePower, the gain also divides by the width of the average and the number of channels
+    float m_decibelGain;
+    float m_decibelFactor;
+
+    // the state of the analysis of a spectrum, which is the one of a single channel or the combined one of all channels
+    struct ChannelState {
+        // index of the channel (of the first one if they are combined) and number of channels
+        size_t channel;
+        size_t channelCount;
+
+        // moving average over the magnitudes (or powers) of the last few fft results, which is used for finding peaks
+        MovingAverage<float> fftAverage;
+
+        // scratch buffers for process, allocated in initialise
+        vector<float> magnitudes;
+        vector<float> powers;
+        vector<float> averagedData;
+        vector<float> binData;
+        vector<float> smoothedData;
+        vector<Peak<float>> peaks;
+
+        // number of peaks found in the last analysed spectrum
+        size_t peakCount;
+
+        // the prominence detector needs scratch space, the other ones are shared by all channels
+        PeakFinder::ProminenceDetector<float> prominenceDetector;
+
+        // the peak histories found so far, which own the peaks
+        PeakTracer<float> peakTracer;
+
+        // features of the passing sources found so far which were not output yet
+        FeatureList eventSpeeds;
+        FeatureList eventFrequencies;
+
+        // number of speed features which were output by process
+        size_t reportedSpeeds;
+    };
+
+    // one state for all channels if they are combined, one per channel otherwise
+    vector<ChannelState> m_channelStates;
+
+    // threads for analysing the channels in parallel, unless they are switched off
+    bool m_parallelChannels;
+    WorkerPool m_workers;
+
+    // Savitzky-Golay filter which smooths the averaged spectrum before the peaks are searched
+    SavitzkyGolay smoothing;
+
+    // the stateless peak detectors, the one to use is selected by m_peakDetector
+    PeakFinder::ThresholdDetector<float> thresholdDetector;
+    PeakFinder::TopKDetector<float> topKDetector;
+
+    // finds the peaks of the spectrum below the upper threshold bin with the given detector and writes them to the peaks of state
+    template<class Detector> size_t findPeaks(ChannelState & state, Detector & detector, const float *spectrum, float threshold,
+                                              RealTime timestamp) {
+        return detector.findPeaks(spectrum, spectrum + m_upperThresholdBin, threshold, timestamp, state.peaks.data(),
+                                  state.peaks.size(), m_peakInterpolation);
+    }
+
+    // calculates the magnitudes (or powers) of the channels of state, the powers of multiple channels are summed up
+    void calculateSpectrum(ChannelState & state, const float *const *inputBuffers);
+
+    // analyses the spectrum of a step: averages and smooths it and traces its peaks
+    // this only changes state, so different states can be analysed in parallel
+    void analyse(ChannelState & state, RealTime timestamp);
+
+    // analyses the averaged spectrum of state: smooths it, finds its peaks and traces them
+    void analyseSpectrum(ChannelState & state, RealTime timestamp);
+
+    // collects the features of the events which ended during the step if they are output online
+    FeatureSet getOnlineFeatures();
+
+    // the peaks are found in the bins of a zero-padded spectrum like in an unpadded one, the values inbetween
+    // only refine the interpolated positions of the peaks
+    void refinePeakPositions(ChannelState & state, size_t peakCount);
+
+    // traces the peaks of a step over time and reports the histories which ended in online or multiple events mode
+    void tracePeaks(ChannelState & state, size_t peakCount, bool allowNew);
+
+    // if the history has a stable begin and end, the speed feature is set and true is returned
+    bool getSpeedFeature(PeakHistory<float> & history, Feature & speed);
+
+    // appends the interpolated positions of the history as dominating frequency features
+    void getDominatingFrequencies(const ChannelState & state, const PeakHistory<float> & history, FeatureList & frequencies);
+
+    // if the history is a passing source, its features are added to the event lists of state and the history is marked as reported
+    bool reportEvent(ChannelState & state, PeakHistory<float> & history);
 
-    // function which traces peaks over time
-    void tracePeaks(const std::vector<Peak<float> *> &peaks, bool allowNew);
+    // labels the feature with the channel of state if the channels are analysed independently
+    void setChannelLabel(const ChannelState & state, Feature & feature);
 
-    // store the history of all found peaks
-    std::vector<std::vector<Peak<float>*>> peakMatrix;
-    std::vector<PeakHistory<float>> peakHistories;
+    /// csv files for debug purposes which get (over)written on every execution, they are written on a separate thread
+    AsyncCsvWriter csvWriter;
 
-    /// csv files for debug purposes which get (over)written on every execution
-    std::ofstream csvfile;
+    /// binary dump of the averaged spectra and their peaks for analysing them again offline
+    SpectrumDumpWriter spectrumDump;
 
 };
 
@@ -0,0 +1,107 @@
+//
+//  EnvelopeFollower.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "EnvelopeFollower.hpp"
+#include "VectorKernels.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+// coefficient of a one pole lowpass with the given time constant in samples
+static float getCoefficient(float time) {
+    return time > 0 ? std::exp(-1.0f / time) : 0.0f;
+}
+
+EnvelopeFollower::EnvelopeFollower():
+    attack(0),
+    release(0),
+    chunkRelease(0),
+    weights(VECTOR_KERNELS_CHUNK_LENGTH, 0),
+    hopSize(1),
+    samplesUntilOutput(1),
+    chunkPosition(0),
+    envelope(0) {
+}
+
+void EnvelopeFollower::initialise(float attackTime, float releaseTime, size_t hopSize) {
+    this->attack = getCoefficient(attackTime);
+    this->release = getCoefficient(releaseTime);
+
+    // in release, the last sample of a chunk has the weight 1 - release, each earlier one is decayed once more
+    float weight = 1.0f - this->release;
+    for (size_t i = VECTOR_KERNELS_CHUNK_LENGTH; i-- > 0; ) {
+        this->weights[i] = weight;
+        weight *= this->release;
+    }
+    this->chunkRelease = std::pow(this->release, (float) VECTOR_KERNELS_CHUNK_LENGTH);
+
+    this->hopSize = std::max<size_t>(hopSize, 1);
+    reset();
+}
+
+void EnvelopeFollower::reset() {
+    this->envelope = 0;
+    this->samplesUntilOutput = this->hopSize;
+    this->chunkPosition = 0;
+}
+
+size_t EnvelopeFollower::process(const float *input, size_t n, float *output) {
+    size_t written = 0;
+    size_t i = 0;
+    while (i < n) {
+        // whole chunks are processed together up to the next output or the end of the input
+        size_t chunks = 0;
+        if (this->chunkPosition == 0) {
+            chunks = std::min(this->samplesUntilOutput, n - i) / VECTOR_KERNELS_CHUNK_LENGTH;
+        }
+
+        size_t length;
+        if (chunks > 0) {
+            this->chunkPeaks.resize(std::max(this->chunkPeaks.size(), chunks));
+            this->chunkSums.resize(std::max(this->chunkSums.size(), chunks));
+            VectorKernels::chunkPeaksAndWeightedSums(input + i, chunks, this->weights.data(),
+                                                     this->chunkPeaks.data(), this->chunkSums.data());
+
+            for (size_t c = 0; c < chunks; ++c) {
+                // the envelope never falls below chunkRelease times its value in a chunk, so if no sample reaches
+                // that, the whole chunk is in release
+                float decayed = this->chunkRelease * this->envelope;
+                if (this->chunkPeaks[c] <= decayed) {
+                    this->envelope = decayed + this->chunkSums[c];
+                } else {
+                    follow(input + i + c * VECTOR_KERNELS_CHUNK_LENGTH, VECTOR_KERNELS_CHUNK_LENGTH);
+                }
+            }
+            length = chunks * VECTOR_KERNELS_CHUNK_LENGTH;
+        } else {
+            // single samples up to the end of the chunk, the next output or the end of the input
+            length = std::min(std::min(VECTOR_KERNELS_CHUNK_LENGTH - this->chunkPosition, this->samplesUntilOutput), n - i);
+            follow(input + i, length);
+            this->chunkPosition = (this->chunkPosition + length) % VECTOR_KERNELS_CHUNK_LENGTH;
+        }
+
+        if (this->envelope < ENVELOPE_MINIMUM) {
+            this->envelope = 0;
+        }
+
+        i += length;
+        this->samplesUntilOutput -= length;
+        if (this->samplesUntilOutput == 0) {
+            output[written++] = this->envelope;
+            this->samplesUntilOutput = this->hopSize;
+        }
+    }
+    return written;
+}
+
+void EnvelopeFollower::follow(const float *input, size_t n) {
+    float envelope = this->envelope;
+    for (size_t i = 0; i < n; ++i) {
+        float value = std::fabs(input[i]);
+        float coefficient = value > envelope ? this->attack : this->release;
+        envelope = coefficient * envelope + (1.0f - coefficient) * value;
+    }
+    this->envelope = envelope;
+}
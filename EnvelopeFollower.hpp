@@ -0,0 +1,69 @@
+//
+//  EnvelopeFollower.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef EnvelopeFollower_hpp
+#define EnvelopeFollower_hpp
+
+#include <stdio.h>
+#include <vector>
+
+// envelopes below this value are set to 0, so a decaying envelope doesn't end up in slow denormal arithmetic
+# define ENVELOPE_MINIMUM 1e-20f
+
+// EnvelopeFollower follows the absolute value of a signal with separate attack and release times:
+// envelope = c * envelope + (1 - c) * |x| with the attack coefficient c if |x| is above the envelope and the release
+// coefficient otherwise. The state is kept between the calls of process, so the signal can be fed in blocks of any
+// length, and the envelope is sampled every hopSize samples.
+// Chunks of VECTOR_KERNELS_CHUNK_LENGTH samples whose maximum stays below the decayed envelope are in release for
+// every sample, so the recursion is replaced by a weighted sum over the chunk (calculated vectorized for all chunks
+// of a block at once). Only the chunks which contain an attack are followed sample by sample.
+class EnvelopeFollower {
+
+public:
+    EnvelopeFollower();
+
+    // attackTime and releaseTime are the time constants in samples, all previous state is discarded
+    void initialise(float attackTime, float releaseTime, size_t hopSize);
+
+    // sets the envelope to 0 and starts a new hop
+    void reset();
+
+    // follows n samples and writes the envelope at each end of a hop to output, returns the number of values written
+    // (at most n / hopSize + 1)
+    size_t process(const float *input, size_t n, float *output);
+
+    // number of samples which have to be processed until the next value is written
+    size_t getSamplesUntilOutput() const {
+        return this->samplesUntilOutput;
+    }
+
+    size_t getHopSize() const {
+        return this->hopSize;
+    }
+
+private:
+    // follows the samples one by one
+    void follow(const float *input, size_t n);
+
+    float attack;
+    float release;
+
+    // the release coefficient to the power of the chunk length, and the weights of the samples of a chunk in release
+    float chunkRelease;
+    std::vector<float> weights;
+
+    size_t hopSize;
+    size_t samplesUntilOutput;
+
+    // position inside the current chunk, chunks are counted from the last reset
+    size_t chunkPosition;
+    float envelope;
+
+    // the maximum values and weighted sums of the chunks of the current block
+    std::vector<float> chunkPeaks;
+    std::vector<float> chunkSums;
+};
+
+#endif /* EnvelopeFollower_hpp */
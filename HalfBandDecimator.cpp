@@ -0,0 +1,127 @@
+//
+//  HalfBandDecimator.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "HalfBandDecimator.hpp"
+#include "VectorKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+HalfBandDecimator::HalfBandDecimator():
+    stages(0),
+    maxLength(0),
+    alignment(0),
+    centerTap(1) {
+}
+
+void HalfBandDecimator::initialise(size_t stages, size_t maxLength) {
+    this->stages = stages;
+    this->maxLength = maxLength;
+
+    // blackman windowed sinc with the cutoff at a quarter of the sample rate, normalized to a gain of 1 at dc
+    size_t half = HALF_BAND_LENGTH / 2;
+    std::vector<double> lowpass(HALF_BAND_LENGTH);
+    double sum = 0;
+    for (size_t i = 0; i < HALF_BAND_LENGTH; ++i) {
+        double t = (double) i - half;
+        double sinc = t == 0 ? 0.5 : sin(M_PI * t / 2) / (M_PI * t);
+        double blackman = 0.42 + 0.5 * cos(M_PI * t / (half + 1)) + 0.08 * cos(2 * M_PI * t / (half + 1));
+        lowpass[i] = sinc * blackman;
+        sum += lowpass[i];
+    }
+    this->taps.resize(half + 1);
+    for (size_t j = 0; j <= half; ++j) {
+        this->taps[j] = (float) (lowpass[2 * j] / sum);
+    }
+    this->centerTap = (float) (lowpass[half] / sum);
+
+    size_t factor = getFactor();
+    size_t lowpassDelay = half * (factor - 1);
+    this->alignment = (factor - lowpassDelay % factor) % factor;
+
+    // a stage gets at most half the samples of the one before (plus one), flush feeds the first one lowpassDelay zeros
+    size_t longest = std::max(maxLength, lowpassDelay) + factor;
+    this->buffers.assign(stages, std::vector<float>(longest + HALF_BAND_LENGTH, 0));
+    this->lengths.assign(stages, 0);
+    this->evenSamples.assign(longest / 2 + HALF_BAND_LENGTH, 0);
+    this->intermediate.assign(longest / 2 + 1, 0);
+    this->flushBuffer.assign(longest + HALF_BAND_LENGTH, 0);
+    reset();
+}
+
+void HalfBandDecimator::reset() {
+    for (size_t s = 0; s < this->stages; ++s) {
+        std::fill(this->buffers[s].begin(), this->buffers[s].end(), 0.0f);
+        this->lengths[s] = HALF_BAND_LENGTH - 1;
+    }
+    if (this->stages > 0) {
+        this->lengths[0] += this->alignment;
+    }
+}
+
+size_t HalfBandDecimator::process(const float *input, size_t n, float *output) {
+    n = std::min(n, this->maxLength);
+    if (this->stages == 0) {
+        std::copy(input, input + n, output);
+        return n;
+    }
+    for (size_t s = 0; s < this->stages; ++s) {
+        // the input is copied into the buffer first, so the intermediate outputs may overwrite it
+        std::copy(input, input + n, this->buffers[s].begin() + this->lengths[s]);
+        this->lengths[s] += n;
+
+        float *stageOutput = s + 1 == this->stages ? output : this->intermediate.data();
+        n = filter(this->buffers[s].data(), this->lengths[s], stageOutput);
+        input = stageOutput;
+    }
+    return n;
+}
+
+size_t HalfBandDecimator::flush(float *output) {
+    if (this->stages == 0) return 0;
+
+    // the stages run on a copy of their buffer, the zeros which are fed to the first one reach the last sample with
+    // the last tap of the lowpass of the whole cascade
+    size_t n = HALF_BAND_LENGTH / 2 * (getFactor() - 1);
+    const float *input = nullptr;
+    for (size_t s = 0; s < this->stages; ++s) {
+        size_t length = this->lengths[s];
+        std::copy(this->buffers[s].begin(), this->buffers[s].begin() + length, this->flushBuffer.begin());
+        if (s == 0) {
+            std::fill(this->flushBuffer.begin() + length, this->flushBuffer.begin() + length + n, 0.0f);
+        } else {
+            std::copy(input, input + n, this->flushBuffer.begin() + length);
+        }
+        length += n;
+
+        float *stageOutput = s + 1 == this->stages ? output : this->intermediate.data();
+        n = filter(this->flushBuffer.data(), length, stageOutput);
+        input = stageOutput;
+    }
+    return n;
+}
+
+size_t HalfBandDecimator::filter(float *buffer, size_t & length, float *output) {
+    if (length < HALF_BAND_LENGTH) return 0;
+
+    // output k is the sum of the taps times buffer[2k] to buffer[2k + HALF_BAND_LENGTH - 1], of which only the even
+    // samples and the one at the center get a nonzero tap
+    size_t half = HALF_BAND_LENGTH / 2;
+    size_t outputs = (length - HALF_BAND_LENGTH) / 2 + 1;
+    for (size_t i = 0; i < outputs + half; ++i) {
+        this->evenSamples[i] = buffer[2 * i];
+    }
+    for (size_t k = 0; k < outputs; ++k) {
+        output[k] = this->centerTap * buffer[2 * k + half];
+    }
+    for (size_t j = 0; j <= half; ++j) {
+        VectorKernels::multiplyAdd(&this->evenSamples[j], output, outputs, this->taps[j]);
+    }
+
+    // the next output starts at buffer[2 * outputs], so the buffer keeps starting at an even sample
+    length -= 2 * outputs;
+    std::copy(buffer + 2 * outputs, buffer + 2 * outputs + length, buffer);
+    return outputs;
+}
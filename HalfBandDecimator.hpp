@@ -0,0 +1,81 @@
+//
+//  HalfBandDecimator.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef HalfBandDecimator_hpp
+#define HalfBandDecimator_hpp
+
+#include <stdio.h>
+#include <vector>
+
+// number of taps of the lowpass of each stage, only the center tap and every second tap around it are nonzero
+# define HALF_BAND_LENGTH 55
+
+// HalfBandDecimator lowpass filters a signal and decimates it by 2 to the power of the number of stages, one
+// half-band stage per factor 2. The windowed sinc lowpass of a stage passes up to 0.2 times its input sample rate
+// (0.4 times its output rate) within 0.002 dB and attenuates everything above 0.3 times its input sample rate by more
+// than 75 dB, so only the upper fifth of the decimated band contains aliases.
+// As every second tap is zero and only every second output is calculated, a stage costs 29 multiply-adds per output
+// (split into vectorized loops over all outputs of a call), i.e. less than 29 per input sample for all stages together.
+// The samples which are still needed for the next outputs are kept, so the signal can be fed in blocks of any length
+// and each sample is filtered only once; the outputs don't depend on how the signal is split into blocks.
+// The outputs whose lowpass reaches beyond the samples fed so far are only returned by flush, as if zeros followed.
+class HalfBandDecimator {
+
+public:
+    HalfBandDecimator();
+
+    // prepares the given number of stages (none passes the signal through) for blocks of up to maxLength samples,
+    // all previous state is discarded
+    void initialise(size_t stages, size_t maxLength);
+
+    // forgets the samples fed so far, the signal is preceded by zeros again
+    void reset();
+
+    // filters n samples (at most maxLength) and writes the decimated samples which are complete to output,
+    // returns the number of values written (at most n / getFactor() + 1)
+    size_t process(const float *input, size_t n, float *output);
+
+    // writes the outputs which follow the ones returned by process if the signal ended with the samples fed so far
+    // and was followed by zeros, i.e. up to the one centered on the last sample; the state isn't changed
+    // returns the number of values written (at most HALF_BAND_LENGTH / 2)
+    size_t flush(float *output);
+
+    size_t getFactor() const {
+        return (size_t) 1 << this->stages;
+    }
+
+    // the k-th output since the last reset is centered on the input sample getFactor() * k - getDelay(),
+    // the signal is preceded by a few more zeros than the lowpass needs to make the delay a multiple of the factor
+    size_t getDelay() const {
+        return HALF_BAND_LENGTH / 2 * (getFactor() - 1) + this->alignment;
+    }
+
+private:
+    // calculates the outputs of a stage from the length samples in buffer and removes the ones which aren't needed
+    // anymore, returns the number of outputs
+    size_t filter(float *buffer, size_t & length, float *output);
+
+    size_t stages;
+    size_t maxLength;
+
+    // the zeros added in front of the signal to align the outputs to multiples of the factor
+    size_t alignment;
+
+    // the nonzero taps besides the center one, i.e. every second tap starting with the first
+    std::vector<float> taps;
+    float centerTap;
+
+    // the samples of each stage which are needed for its next outputs followed by the new ones, starting at an even sample
+    std::vector<std::vector<float>> buffers;
+    std::vector<size_t> lengths;
+
+    // the even samples of the buffer of the current stage, the outputs of the intermediate stages
+    // and a copy of the buffer of the current stage for flush
+    std::vector<float> evenSamples;
+    std::vector<float> intermediate;
+    std::vector<float> flushBuffer;
+};
+
+#endif /* HalfBandDecimator_hpp */
@@ -0,0 +1,81 @@
+//
+//  MappedFile.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile():
+    data(nullptr),
+    size(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string & path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    this->data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    this->size = (size_t) fileSize.QuadPart;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        mapped = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    this->data = static_cast<const char *>(mapped);
+    this->size = (size_t) status.st_size;
+#endif
+    if (this->data == nullptr) {
+        this->size = 0;
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+#else
+    munmap(const_cast<char *>(this->data), this->size);
+#endif
+    this->data = nullptr;
+    this->size = 0;
+}
@@ -0,0 +1,45 @@
+//
+//  MappedFile.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <stdio.h>
+#include <string>
+
+// MappedFile maps a whole file read-only into memory, so it is read directly from the page cache without copying it
+class MappedFile {
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    // maps the file, a file which was mapped before is unmapped first
+    // returns false if the file can't be opened, is empty or can't be mapped
+    bool open(const std::string & path);
+
+    void close();
+
+    bool isOpen() const {
+        return this->data != nullptr;
+    }
+
+    const char* getData() const {
+        return this->data;
+    }
+
+    size_t getSize() const {
+        return this->size;
+    }
+
+private:
+    const char *data;
+    size_t size;
+};
+
+#endif /* MappedFile_hpp */
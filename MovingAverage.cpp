@@ -0,0 +1,114 @@
+//
+//  MovingAverage.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "MovingAverage.hpp"
+#include <algorithm>
+#include <math.h>
+
+template<typename T> MovingAverage<T>::MovingAverage():
+    width(0),
+    frameSize(0),
+    next(0),
+    count(0),
+    addedSinceRecalculation(0),
+    frames(std::vector<T>()),
+    accumulators(std::vector<double>()),
+    sums(std::vector<T>()) {
+}
+
+template<typename T> void MovingAverage<T>::initialise(size_t width, size_t frameSize) {
+    this->width = std::max<size_t>(width, 1);
+    this->frameSize = frameSize;
+    this->frames.assign(this->width * frameSize, 0);
+    this->accumulators.assign(frameSize, 0);
+    this->sums.assign(frameSize, 0);
+    this->next = 0;
+    this->count = 0;
+    this->addedSinceRecalculation = 0;
+}
+
+template<typename T> void MovingAverage<T>::reset() {
+    std::fill(frames.begin(), frames.end(), 0);
+    std::fill(accumulators.begin(), accumulators.end(), 0);
+    std::fill(sums.begin(), sums.end(), 0);
+    this->next = 0;
+    this->count = 0;
+    this->addedSinceRecalculation = 0;
+}
+
+template<typename T> void MovingAverage<T>::add(const T *frame) {
+    T *slot = &frames[next * frameSize];
+    double *accumulator = accumulators.data();
+    T *sum = sums.data();
+
+    // subtract the oldest frame and add the newest one
+    // (slots which were never written are zero, so this also works while the window fills up)
+    for (size_t i = 0; i < frameSize; ++i) {
+        accumulator[i] += (double) frame[i] - (double) slot[i];
+    }
+    for (size_t i = 0; i < frameSize; ++i) {
+        sum[i] = (T) accumulator[i];
+    }
+
+    // the loops are kept simple so that they are vectorized, the sums are only fixed bin by bin if one was cancelled
+    int cancelled = 0;
+    for (size_t i = 0; i < frameSize; ++i) {
+        cancelled |= fabs(slot[i]) > MOVING_AVERAGE_CANCELLATION_RATIO * fabs(sum[i]);
+    }
+    if (cancelled) {
+        for (size_t i = 0; i < frameSize; ++i) {
+            if (fabs(slot[i]) > MOVING_AVERAGE_CANCELLATION_RATIO * fabs(sum[i])) {
+                slot[i] = frame[i];
+                recalculateSum(i);
+                sum[i] = (T) accumulator[i];
+            }
+        }
+    }
+    std::copy(frame, frame + frameSize, slot);
+
+    next = (next + 1) % width;
+    if (count < width) {
+        count++;
+    }
+
+    if (++addedSinceRecalculation >= MOVING_AVERAGE_RECALCULATION_INTERVAL) {
+        recalculateSums();
+    }
+}
+
+template<typename T> void MovingAverage<T>::getAverage(T *output) const {
+    const T *sum = sums.data();
+    for (size_t i = 0; i < frameSize; ++i) {
+        output[i] = sum[i] / width;
+    }
+}
+
+template<typename T> void MovingAverage<T>::recalculateSums() {
+    std::fill(accumulators.begin(), accumulators.end(), 0);
+    double *accumulator = accumulators.data();
+    for (size_t f = 0; f < width; ++f) {
+        const T *frame = &frames[f * frameSize];
+        for (size_t i = 0; i < frameSize; ++i) {
+            accumulator[i] += frame[i];
+        }
+    }
+    for (size_t i = 0; i < frameSize; ++i) {
+        sums[i] = (T) accumulator[i];
+    }
+    addedSinceRecalculation = 0;
+}
+
+template<typename T> void MovingAverage<T>::recalculateSum(size_t bin) {
+    double sum = 0;
+    for (size_t f = 0; f < width; ++f) {
+        sum += frames[f * frameSize + bin];
+    }
+    accumulators[bin] = sum;
+}
+
+
+// template initializations
+template class MovingAverage<float>;
+template class MovingAverage<double>;
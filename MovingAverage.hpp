@@ -0,0 +1,80 @@
+//
+//  MovingAverage.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef MovingAverage_hpp
+#define MovingAverage_hpp
+
+#include <stdio.h>
+#include <vector>
+
+// number of added frames after which the running sums are recalculated from scratch
+// to get rid of the floating point drift caused by adding and subtracting over and over again
+# define MOVING_AVERAGE_RECALCULATION_INTERVAL 256
+
+// a sum is recalculated from the frames in the window as soon as the removed value is this many times larger than it,
+// because the cancellation would leave mostly rounding errors of the removed value (e.g. loud input followed by silence)
+# define MOVING_AVERAGE_CANCELLATION_RATIO 1024
+
+// MovingAverage averages the last few frames (e.g. fft magnitudes) bin by bin. The frames are kept
+// in a ring buffer and the sum of each bin is updated incrementally, so adding a frame costs
+// O(frameSize) no matter how wide the window is. The sums are accumulated in double precision.
+template<typename T> class MovingAverage {
+
+public:
+    MovingAverage();
+
+    // prepares the ring buffer for the given number of frames with frameSize values each, all previous data is discarded
+    void initialise(size_t width, size_t frameSize);
+
+    // forget all frames added so far
+    void reset();
+
+    // adds a frame of frameSize values, replacing the oldest frame if the window is already full
+    void add(const T *frame);
+
+    // writes the bin-wise average of the frames in the window to output (frameSize values)
+    void getAverage(T *output) const;
+
+    // the bin-wise sums of the frames in the window (frameSize values), divide by getWidth() for the average
+    const T* getSums() const {
+        return this->sums.data();
+    }
+
+    // returns whether width frames have been added, i.e. the average covers the whole window
+    bool isFull() const {
+        return this->count == this->width;
+    }
+
+    size_t getWidth() const {
+        return this->width;
+    }
+
+    size_t getFrameSize() const {
+        return this->frameSize;
+    }
+
+private:
+    // recalculates the running sums from the frames in the ring buffer
+    void recalculateSums();
+
+    // recalculates the running sum of a single bin
+    void recalculateSum(size_t bin);
+
+    size_t width;
+    size_t frameSize;
+
+    // index of the slot in the ring buffer which gets overwritten next
+    size_t next;
+    size_t count;
+    size_t addedSinceRecalculation;
+
+    // width * frameSize values, frame i starts at i * frameSize
+    std::vector<T> frames;
+    std::vector<double> accumulators;
+    // the accumulators rounded to T
+    std::vector<T> sums;
+};
+
+#endif /* MovingAverage_hpp */
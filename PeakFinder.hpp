@@ -12,8 +12,12 @@
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include <vamp-sdk/Plugin.h>
 
+// number of peaks a PeakPool allocates at once
+# define PEAK_POOL_CHUNK_SIZE 1024
+
 using Vamp::RealTime;
 
 namespace PeakFinder {
@@ -34,18 +38,121 @@ namespace PeakFinder {
             value(other.value), timestamp(other.timestamp), height(other.height), position(other.position),
             interpolatedPosition(other.interpolatedPosition)
         { }
+
+        Peak<T>& operator=(const Peak<T> & other) = default;
     };
 
+    // PeakPool owns peaks and hands out pointers to them which stay valid until they are released or the pool is cleared.
+    // Peaks are stored in chunks of fixed size, so only every chunkSize-th peak needs a heap allocation.
+    // Released peaks and the chunks of a cleared pool are reused.
+    template<class T> class PeakPool {
+    public:
+        PeakPool(size_t chunkSize = PEAK_POOL_CHUNK_SIZE): chunkSize(chunkSize), used(0) {}
+
+        // stores a copy of the given peak in the pool
+        Peak<T>* acquire(const Peak<T> & peak);
+
+        // gives a peak back to the pool, it must not be used any more afterwards
+        void release(const Peak<T> *peak) {
+            freePeaks.push_back(const_cast<Peak<T>*>(peak));
+        }
+
+        // invalidates all peaks handed out so far
+        void clear() {
+            used = 0;
+            freePeaks.clear();
+        }
+
+        // number of peaks which are currently handed out
+        size_t size() const {
+            return used - freePeaks.size();
+        }
+
+    private:
+        std::vector<std::vector<Peak<T>>> chunks;
+        std::vector<Peak<T>*> freePeaks;
+        size_t chunkSize;
+        size_t used;
+    };
+
+    // how the interpolatedPosition of a peak is calculated from the peak and its two neighbours
+    enum Interpolation {
+        noInterpolation,        // the position of the peak itself
+        parabolicInterpolation, // vertex of the parabola through the three values (for dB values this is the log-quadratic fit)
+        gaussianInterpolation   // vertex of the parabola through the logarithms of the three values, which must be positive
+    };
+
+    // returns the offset (between -0.5 and 0.5) of the interpolated maximum from the position of peak
+    template <class T>
+    double interpolationOffset(T left, T peak, T right, Interpolation interpolation);
+
     // find peaks by returning those elements where the next valleys on both sides are at least one threshold lower
     // the provided timestamp is set on the peak for later reference
     template <class Iterator, class T = typename std::iterator_traits<Iterator>::value_type>
-    std::vector<Peak<T>*> findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp);
+    std::vector<Peak<T>*> findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp,
+                                             Interpolation interpolation = noInterpolation);
+
+    // same as above, but the peaks are written by value to output, which is provided by the caller and has room for capacity peaks
+    // returns the number of peaks written, further peaks are dropped. There can't be more than (end - begin) / 2 + 1 peaks,
+    // so a buffer of this size is always sufficient.
+    template <class Iterator, class T = typename std::iterator_traits<Iterator>::value_type>
+    size_t findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp, Peak<T> *output, size_t capacity,
+                              Interpolation interpolation = noInterpolation);
+
+    // walks through the data and calls emit for every peak which is at least threshold high (implementation of findPeaksThreshold)
+    template <class Iterator, class T, class Emit>
+    void walkPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp, Interpolation interpolation, Emit emit);
 
     enum SignalDirection {
         ascending,
         descending,
         stagnating
     };
+
+    // Peak detectors are interchangeable strategies for finding the peaks in a spectrum. They all provide
+    //   template <class Iterator> size_t findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp,
+    //                                              Peak<T> *output, size_t capacity, Interpolation interpolation)
+    // which writes the found peaks ordered by position to output and returns their number (like findPeaksThreshold).
+    // They are meant to be used as template arguments, so the loops over the bins are compiled for each detector.
+
+    // the valley walker of findPeaksThreshold: the next valleys on both sides must be at least threshold lower than the peak
+    template<class T> struct ThresholdDetector {
+        template <class Iterator>
+        size_t findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp, Peak<T> *output, size_t capacity,
+                         Interpolation interpolation = noInterpolation) {
+            return findPeaksThreshold(begin, end, threshold, timestamp, output, capacity, interpolation);
+        }
+    };
+
+    // finds the peaks whose prominence is at least threshold. The prominence is the height of a peak above the higher one of
+    // the lowest points on both sides before the signal gets higher than the peak again (or the data ends). Small dips on
+    // the flanks of a peak therefore don't hide it, unlike with the ThresholdDetector. The height of the peaks is their prominence.
+    // The bases are found with a monotonic stack in two passes, so the detector is O(n) and keeps the stack between the calls.
+    template<class T> class ProminenceDetector {
+    public:
+        template <class Iterator>
+        size_t findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp, Peak<T> *output, size_t capacity,
+                         Interpolation interpolation = noInterpolation);
+
+    private:
+        // pushes value onto the stack of decreasing values and returns the lowest value between value
+        // and the next higher value (the value itself if there is nothing inbetween)
+        T pushBase(T value);
+
+        // pairs of a value and the lowest value between it and the stack entry below it
+        std::vector<std::pair<T, T>> stack;
+    };
+
+    // finds the peaks like the ThresholdDetector, but only keeps the k highest ones
+    template<class T> struct TopKDetector {
+        size_t k;
+
+        TopKDetector(size_t k = 1): k(k) {}
+
+        template <class Iterator>
+        size_t findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp, Peak<T> *output, size_t capacity,
+                         Interpolation interpolation = noInterpolation);
+    };
 }
 
 /////////// implementation of template functions
@@ -53,14 +160,78 @@ namespace PeakFinder {
 using std::vector;
 using std::pair;
 
+template<class T>
+PeakFinder::Peak<T>* PeakFinder::PeakPool<T>::acquire(const Peak<T> & peak) {
+    if (!freePeaks.empty()) {
+        Peak<T> *reused = freePeaks.back();
+        freePeaks.pop_back();
+        *reused = peak;
+        return reused;
+    }
+
+    size_t chunk = used / chunkSize;
+    if (chunk == chunks.size()) {
+        chunks.emplace_back();
+        chunks.back().reserve(chunkSize);
+    }
+    std::vector<Peak<T>> & storage = chunks[chunk];
+    size_t index = used % chunkSize;
+    if (index < storage.size()) {
+        storage[index] = peak;
+    } else {
+        storage.push_back(peak);
+    }
+    used++;
+    return &storage[index];
+}
+
+template <class T>
+double PeakFinder::interpolationOffset(T left, T peak, T right, Interpolation interpolation) {
+    double a = left, b = peak, c = right;
+    if (interpolation == gaussianInterpolation) {
+        a = std::log(a);
+        b = std::log(b);
+        c = std::log(c);
+    } else if (interpolation != parabolicInterpolation) {
+        return 0;
+    }
+
+    double curvature = a - 2 * b + c;
+    if (!(curvature < 0)) {    // no maximum (or invalid values)
+        return 0;
+    }
+    return std::max(-0.5, std::min(0.5, 0.5 * (a - c) / curvature));
+}
+
 template <class Iterator, class T>
-std::vector<PeakFinder::Peak<T>*> PeakFinder::findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp) {
+std::vector<PeakFinder::Peak<T>*> PeakFinder::findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp,
+                                                                 Interpolation interpolation) {
     vector<PeakFinder::Peak<T>*> outputBuffer;
+    walkPeaksThreshold(begin, end, threshold, timestamp, interpolation, [&outputBuffer](const Peak<T> & peak) {
+        outputBuffer.push_back(new PeakFinder::Peak<T>(peak));
+    });
+    return outputBuffer;
+}
 
+template <class Iterator, class T>
+size_t PeakFinder::findPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp, Peak<T> *output, size_t capacity,
+                                      Interpolation interpolation) {
+    size_t count = 0;
+    walkPeaksThreshold(begin, end, threshold, timestamp, interpolation, [output, capacity, &count](const Peak<T> & peak) {
+        if (count < capacity) {
+            output[count++] = peak;
+        }
+    });
+    return count;
+}
+
+template <class Iterator, class T, class Emit>
+void PeakFinder::walkPeaksThreshold(Iterator begin, Iterator end, T threshold, RealTime timestamp, Interpolation interpolation, Emit emit) {
     SignalDirection direction = stagnating;
     size_t index = 0;
 
     T previous = *begin;
+    T beforePrevious = previous;
     T current;
     T height;
 
@@ -77,7 +248,8 @@ std::vector<PeakFinder::Peak<T>*> PeakFinder::findPeaksThreshold(Iterator begin,
                 height = previous - lastValley.second;
                 // if the height is sufficient, make it a candidate
                 if (height >= threshold) {
-                    candidate = PeakFinder::Peak<float>(previous, height, index - 1, index - 1, timestamp);
+                    double offset = index >= 2 ? interpolationOffset(beforePrevious, previous, current, interpolation) : 0;
+                    candidate = PeakFinder::Peak<T>(previous, height, index - 1, index - 1 + offset, timestamp);
                     validCandidate = true;
                 }
             }
@@ -92,7 +264,7 @@ std::vector<PeakFinder::Peak<T>*> PeakFinder::findPeaksThreshold(Iterator begin,
                     // if the height is sufficient, make the candidate a peak
                     if (height >= threshold) {
                         candidate.height = std::min(candidate.height, height);
-                        outputBuffer.push_back(new PeakFinder::Peak<float>(candidate));
+                        emit(candidate);
                     }
                 }
                 validCandidate = false;
@@ -101,11 +273,87 @@ std::vector<PeakFinder::Peak<T>*> PeakFinder::findPeaksThreshold(Iterator begin,
             direction = SignalDirection::stagnating;
         }
 
+        beforePrevious = previous;
         previous = current;
         index++;
     }
+}
 
-    return outputBuffer;
+template<class T>
+T PeakFinder::ProminenceDetector<T>::pushBase(T value) {
+    T lowest = value;
+    while (!stack.empty() && stack.back().first <= value) {
+        lowest = std::min(lowest, std::min(stack.back().first, stack.back().second));
+        stack.pop_back();
+    }
+    stack.push_back(std::make_pair(value, lowest));
+    return lowest;
+}
+
+template<class T> template <class Iterator>
+size_t PeakFinder::ProminenceDetector<T>::findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp,
+                                                    Peak<T> *output, size_t capacity, Interpolation interpolation) {
+    if (begin >= end) {
+        return 0;
+    }
+
+    // forward pass: find the local maxima (the last value of a plateau if it is flat) and their bases on the left side
+    size_t count = 0;
+    stack.clear();
+    T beforePrevious = *begin;
+    T previous = *begin;
+    T leftBaseOfPrevious = *begin;
+    size_t index = 0;
+    for (auto it = begin; it < end; ++it, ++index) {
+        T current = *it;
+        T leftBase = pushBase(current);
+        if (index >= 1 && current < previous && previous >= beforePrevious && count < capacity) {
+            double offset = index >= 2 ? interpolationOffset(beforePrevious, previous, current, interpolation) : 0;
+            output[count++] = Peak<T>(previous, previous - leftBaseOfPrevious, index - 1, index - 1 + offset, timestamp);
+        }
+        leftBaseOfPrevious = leftBase;
+        beforePrevious = previous;
+        previous = current;
+    }
+
+    // backward pass: find the bases on the right side and keep the peaks which are prominent enough
+    stack.clear();
+    size_t peak = count;
+    index = end - begin;
+    for (auto it = end; it > begin && peak > 0;) {
+        --it;
+        --index;
+        T rightBase = pushBase(*it);
+        if (output[peak - 1].position == index) {
+            --peak;
+            Peak<T> & candidate = output[peak];
+            candidate.height = std::min(candidate.height, candidate.value - rightBase);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (output[i].height > 0 && output[i].height >= threshold) {
+            output[kept++] = output[i];
+        }
+    }
+    return kept;
+}
+
+template<class T> template <class Iterator>
+size_t PeakFinder::TopKDetector<T>::findPeaks(Iterator begin, Iterator end, T threshold, RealTime timestamp,
+                                              Peak<T> *output, size_t capacity, Interpolation interpolation) {
+    size_t count = findPeaksThreshold(begin, end, threshold, timestamp, output, capacity, interpolation);
+    if (count > k) {
+        std::nth_element(output, output + k, output + count, [](const Peak<T> & a, const Peak<T> & b) {
+            return a.height > b.height;
+        });
+        std::sort(output, output + k, [](const Peak<T> & a, const Peak<T> & b) {
+            return a.position < b.position;
+        });
+        count = k;
+    }
+    return count;
 }
 
 
@@ -9,26 +9,97 @@
 #include "PeakHistory.hpp"
 #include <math.h>
 
-template<typename T> PeakHistory<T>::PeakHistory(size_t broadestAllowedInterruption):
+template<typename T> PeakHistory<T>::PeakHistory(size_t broadestAllowedInterruption, size_t maxLength):
     peaks(std::vector<const Peak<T>*>()),
+    maxLength(maxLength),
+    oldest(0),
+    firstPeak(Peak<T>()),
+    stableBegin(Peak<T>()),
+    hasStableBegin(false),
+    beginStableValue(0.0),
+    beginStableLength(0),
+    addedPeaks(0),
     broadestAllowedInterruption(broadestAllowedInterruption),
     sumOfHeights(0),
     total(0),
     missed(0),
     recentlyMissed(0),
-    alive(true) {
+    alive(true),
+    reported(false) {
+        if (maxLength > 0) {
+            peaks.reserve(maxLength);
+        }
 }
 
-template<typename T> PeakHistory<T>::PeakHistory(Peak<T> *initalPeak, size_t broadestAllowedInterruption):
-    PeakHistory<T>::PeakHistory(broadestAllowedInterruption) {
+template<typename T> PeakHistory<T>::PeakHistory(Peak<T> *initalPeak, size_t broadestAllowedInterruption, size_t maxLength):
+    PeakHistory<T>::PeakHistory(broadestAllowedInterruption, maxLength) {
         this->addPeak(initalPeak);
 }
 
-template<typename T> void PeakHistory<T>::addPeak(const Peak<T> *peak) {
-    this->peaks.push_back(peak);
+template<typename T> void PeakHistory<T>::restart(const Peak<T> *initialPeak) {
+    this->peaks.clear();
+    this->oldest = 0;
+    this->firstPeak = Peak<T>();
+    this->stableBegin = Peak<T>();
+    this->hasStableBegin = false;
+    this->beginStableValue = 0.0;
+    this->beginStableLength = 0;
+    this->addedPeaks = 0;
+    this->sumOfHeights = 0;
+    this->total = 0;
+    this->missed = 0;
+    this->recentlyMissed = 0;
+    this->alive = true;
+    this->reported = false;
+    this->addPeak(initialPeak);
+}
+
+template<typename T> const Peak<T>* PeakHistory<T>::addPeak(const Peak<T> *peak) {
+    const Peak<T> *dropped = nullptr;
+    if (maxLength > 0 && peaks.size() == maxLength) {
+        dropped = peaks[oldest];
+        peaks[oldest] = peak;
+        oldest = (oldest + 1) % maxLength;
+    } else {
+        this->peaks.push_back(peak);
+    }
+
+    if (this->total == 0) {
+        firstPeak = *peak;
+    }
+
+    // continue the search for the stable begin
+    if (!hasStableBegin) {
+        if (beginStableValue == peak->position) {
+            beginStableLength++;
+        } else {
+            beginStableLength = 0;
+            beginStableValue = peak->position;
+        }
+
+        if (beginStableLength >= STABLE_LENGTH_MINIMUM) {
+            stableBegin = *peak;
+            hasStableBegin = true;
+        }
+    }
+
+    // remember the stable end found from this peak on
+    size_t number = addedPeaks++;
+    recentPositions[number % STABLE_END_WINDOW] = peak->interpolatedPosition;
+    recentStableEnds[number % STABLE_END_WINDOW] = findStableEnd(number);
+
     recentlyMissed = 0;
     sumOfHeights += peak->height;
     this->total++;
+    return dropped;
+}
+
+template<typename T> void PeakHistory<T>::releasePeaks(PeakFinder::PeakPool<T> & pool) {
+    for (auto peak : this->peaks) {
+        pool.release(peak);
+    }
+    this->peaks.clear();
+    this->oldest = 0;
 }
 
 template<typename T> void PeakHistory<T>::noPeak() {
@@ -38,50 +109,56 @@ template<typename T> void PeakHistory<T>::noPeak() {
 }
 
 template<typename T> const Peak<T>* PeakHistory<T>::getStableBegin() {
-    size_t stableLength = 0;
-    double stableValue = 0.0;
+    // the first stable streak never changes once it is found, so it is searched while adding the peaks
+    return hasStableBegin ? &stableBegin : nullptr;
+}
 
-    for (const Peak<T>* peak : this->peaks) {
-        if (stableValue == peak->interpolatedPosition) {
-            stableLength++;
-        } else {
-            stableLength = 0;
-            stableValue = peak->interpolatedPosition;
+template<typename T> size_t PeakHistory<T>::findStableEnd(size_t start) const {
+    double stableValue = recentPositions[start % STABLE_END_WINDOW];
+    for (size_t i = 1; i <= STABLE_LENGTH_MINIMUM + 1; ++i) {
+        if (i > start) {
+            return NO_STABLE_END;
         }
-
-        if (stableLength >= STABLE_LENGTH_MINIMUM) {
-            return peak;
+        size_t number = start - i;
+        if (fabs(stableValue - recentPositions[number % STABLE_END_WINDOW]) > 1) {
+            // the older peak starts the next streak
+            return recentStableEnds[number % STABLE_END_WINDOW];
         }
     }
-
-    // no stable streak found --> return NULL
-    return nullptr;
+    return start - (STABLE_LENGTH_MINIMUM + 1);
 }
 
 template<typename T> const Peak<T>* PeakHistory<T>::getStableEnd() {
-    size_t stableLength = 0;
-    double stableValue = 0.0;
+    if (peaks.empty()) {
+        return nullptr;
+    }
 
-    for (auto it = peaks.rbegin(); it < peaks.rend(); ++it) {
-        auto peak = *it;
-        if (fabs(stableValue - peak->interpolatedPosition) <= 1) {
-            stableLength++;
-        } else {
-            stableLength = 0;
-            stableValue = peak->interpolatedPosition;
+    // the newest peak starts the first streak unless it is within +-1 of 0, then the streak is counted from 0 on
+    // and already stable after STABLE_LENGTH_MINIMUM + 1 peaks
+    size_t newest = addedPeaks - 1;
+    size_t stableEnd = NO_STABLE_END;
+    for (size_t i = 0; i <= STABLE_LENGTH_MINIMUM && i <= newest; ++i) {
+        size_t number = newest - i;
+        if (fabs(0.0 - recentPositions[number % STABLE_END_WINDOW]) > 1) {
+            stableEnd = recentStableEnds[number % STABLE_END_WINDOW];
+            break;
         }
-
-        if (stableLength > STABLE_LENGTH_MINIMUM) {
-            return peak;
+        if (i == STABLE_LENGTH_MINIMUM) {
+            stableEnd = number;
         }
     }
 
-    // no stable streak found --> return NULL
-    return nullptr;
+    // only the kept peaks are searched
+    size_t firstKept = addedPeaks - peaks.size();
+    if (stableEnd == NO_STABLE_END || stableEnd < firstKept) {
+        return nullptr;
+    }
+    return kept(stableEnd - firstKept);
 }
 
 template<typename T> void PeakHistory<T>::getInterpolatedPositionHistory(std::vector<std::pair<Vamp::RealTime, double>>& resultVector) const {
-    for (auto peak : this->peaks) {
+    for (size_t i = 0; i < peaks.size(); ++i) {
+        auto peak = kept(i);
         resultVector.push_back(std::pair<Vamp::RealTime, double>(peak->timestamp, peak->interpolatedPosition));
     }
 }
@@ -89,3 +166,4 @@ template<typename T> void PeakHistory<T>::getInterpolatedPositionHistory(std::ve
 
 // template initializations
 template class PeakHistory<float>;
+template class PeakHistory<double>;
@@ -15,18 +15,35 @@
 
 # define STABLE_LENGTH_MINIMUM 3
 
+// number of most recent peaks whose positions and stable ends are remembered to find the stable end incrementally
+# define STABLE_END_WINDOW (STABLE_LENGTH_MINIMUM + 2)
+
+// a history which missed too many peaks is kept nonetheless if it has a stable begin before and a stable end after these points in time
+# define KEEP_STABLE_BEGIN_BEFORE 2 // s
+# define KEEP_STABLE_END_AFTER 4 // s
+
 using PeakFinder::Peak;
 
 // PeakHistory is responsible for grouping together a set of peaks over time which probably
 // belong together. It provides convenient access to the set by the following set of functions
+// If maxLength is set, only the most recent maxLength peaks are kept, which bounds the memory
+// needed for arbitrarily long histories.
 template<typename T> class PeakHistory {
 
 public:
-    PeakHistory(size_t broadestAllowedInterruption);
-    PeakHistory(Peak<T> *initalPeak, size_t broadestAllowedInterruption);
+    PeakHistory(size_t broadestAllowedInterruption, size_t maxLength = 0);
+    PeakHistory(Peak<T> *initalPeak, size_t broadestAllowedInterruption, size_t maxLength = 0);
+
+    // makes this an empty history which starts with initialPeak, the memory for the peaks is kept
+    // the peaks of the history must have been released before
+    void restart(const Peak<T> *initialPeak);
 
     // add a peak to the peak history, resets the number of recently missed peaks
-    void addPeak(const Peak<T> *peak);
+    // returns the peak which was dropped to make room for the new one or nullptr if none was dropped
+    const Peak<T>* addPeak(const Peak<T> *peak);
+
+    // gives all kept peaks back to the pool, afterwards the history only provides its summary values
+    void releasePeaks(PeakFinder::PeakPool<T> & pool);
 
     // add nothing but tell the PeakHistory that a peak at this position was not found
     void noPeak();
@@ -43,11 +60,11 @@ public:
     }
 
     const Peak<T>* getFirst() const {
-        return this->peaks.at(0);
+        return &this->firstPeak;
     }
 
     const Peak<T>* getLast() const {
-        return this->peaks.at(peaks.size() - 1);
+        return this->kept(peaks.size() - 1);
     }
 
     // return a Peak* within the stable beginning of the history or nullptr if there is none
@@ -56,16 +73,19 @@ public:
 
     // returns a peak within the stable end of the history of nullptr if there is none
     // stable means a +-1 range for at least three times
+    // if the length of the history is limited, only the kept peaks are searched
+    // the search is done while the peaks are added, so this is O(1)
     const Peak<T>* getStableEnd();
 
     // returns whether this peak history is still valid
-    // it is alive if there were not too many peaks missed or there is a stable beginning and end at the right time
-    bool isAlive() {
+    // it is alive if there were not too many peaks missed or (if keepStable is set) there is a stable beginning and end at the right time
+    bool isAlive(bool keepStable = true) {
         alive = alive && recentlyMissed < broadestAllowedInterruption;
-        if (!alive) {
+        if (!alive && keepStable) {
             auto begin = this->getStableBegin();
             auto end = this->getStableEnd();
-            alive = alive || (begin && end && begin->timestamp.sec < 2 && end->timestamp.sec >= 4 && begin->interpolatedPosition > end->interpolatedPosition);
+            alive = alive || (begin && end && begin->timestamp.sec < KEEP_STABLE_BEGIN_BEFORE && end->timestamp.sec >= KEEP_STABLE_END_AFTER &&
+                              begin->interpolatedPosition > end->interpolatedPosition);
         }
 //        if (!alive) {
 //            std::cerr << getLast()->interpolatedPosition << " (time " << getLast()->timestamp.sec*1000 + getLast()->timestamp.msec() << ", height " << getAveragePeakHeight() << ") is not alive any more :( \n";
@@ -73,6 +93,21 @@ public:
         return alive;
     }
 
+    // returns whether too many peaks were missed recently, i.e. the source of the history has gone
+    // (in contrast to isAlive this does not consider whether the history is worth being kept)
+    bool hasEnded() const {
+        return recentlyMissed >= broadestAllowedInterruption;
+    }
+
+    // whether a result was already output for this history
+    bool isReported() const {
+        return this->reported;
+    }
+
+    void setReported() {
+        this->reported = true;
+    }
+
     size_t size() const {
         return this->total;
     }
@@ -82,7 +117,39 @@ public:
     }
 
 private:
+    // returns the i-th oldest of the kept peaks
+    const Peak<T>* kept(size_t i) const {
+        return this->peaks.at((oldest + i) % peaks.size());
+    }
+
+    // ring buffer if maxLength is set, the oldest kept peak is at index oldest
     std::vector<const Peak<T> *> peaks;
+    size_t maxLength;
+    size_t oldest;
+
+    // copies of the first peak and the stable begin, which stay valid if the peaks are dropped
+    Peak<T> firstPeak;
+    Peak<T> stableBegin;
+    bool hasStableBegin;
+
+    // state of the search for the stable begin, which is done while the peaks are added
+    double beginStableValue;
+    size_t beginStableLength;
+
+    // The stable end is the first streak found when going back from the newest peak: a peak starts a streak, which is
+    // stable once the next STABLE_LENGTH_MINIMUM + 1 older peaks are within +-1 of it, and the first peak which isn't
+    // starts the next streak. So the stable end found from a peak only depends on the older peaks and is calculated
+    // once when the peak is added, using the ones of the STABLE_END_WINDOW most recent peaks.
+    // returns the number of the peak which ends the first stable streak found from peak number start or NO_STABLE_END
+    size_t findStableEnd(size_t start) const;
+
+    static const size_t NO_STABLE_END = (size_t) -1;
+
+    // number of peaks added so far (in contrast to total, which also counts the missed ones)
+    size_t addedPeaks;
+    // positions and stable ends of the most recently added peaks, peak number i is at index i % STABLE_END_WINDOW
+    double recentPositions[STABLE_END_WINDOW];
+    size_t recentStableEnds[STABLE_END_WINDOW];
 
     size_t broadestAllowedInterruption;
 
@@ -93,6 +160,7 @@ private:
     size_t recentlyMissed;
      
     bool alive;
+    bool reported;
 };
 
 #endif /* PeakHistory_hpp */
@@ -0,0 +1,302 @@
+//
+//  PeakTracer.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "PeakTracer.hpp"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <iostream>
+#include <math.h>
+
+// choices of the dynamic programming in assignOptimally
+#define SKIP_HISTORY 0
+#define SKIP_PEAK 1
+#define MATCH 2
+
+template<typename T> PeakTracer<T>::PeakTracer():
+    maxBinJump(0),
+    broadestAllowedInterruption(0),
+    maxHistoryLength(0),
+    newHistoryHeightThreshold(0),
+    mode(greedyMode),
+    pool(PeakFinder::PeakPool<T>()) {
+}
+
+template<typename T> void PeakTracer<T>::initialise(double maxBinJump, size_t broadestAllowedInterruption, size_t maxHistoryLength,
+                                                    T newHistoryHeightThreshold, Mode mode) {
+    this->maxBinJump = maxBinJump;
+    this->broadestAllowedInterruption = broadestAllowedInterruption;
+    this->maxHistoryLength = maxHistoryLength;
+    this->newHistoryHeightThreshold = newHistoryHeightThreshold;
+    this->mode = mode;
+    reset();
+}
+
+template<typename T> void PeakTracer<T>::reset() {
+    // the histories are dropped as well, as they were set up with the old parameters
+    this->histories.clear();
+    this->freeSlots.clear();
+    this->active.clear();
+    this->added.clear();
+    this->pool.clear();
+}
+
+template<typename T> void PeakTracer<T>::assignGreedily(const Peak<T> *peaks, size_t peakCount, bool allowNew) {
+    // current and last are indices into active, count is the number of histories before this step
+    size_t count = this->active.size();
+    size_t current = 0;
+    size_t last = 0;
+
+    double currentPosition = 0;
+    double lastPosition = count > 0 ? position(this->active[0]) : std::numeric_limits<double>::min();
+
+    bool addedPeakToLast = false;
+    bool addedPeakToCurrent = false;
+
+    // iterate through the peaks and histories at the same time
+    // invariant: both are sorted by the position ascendingly
+    for (size_t p = 0; p < peakCount; ++p) {
+        const Peak<T> & peak = peaks[p];
+        bool peakDone = false;
+        while (current < count && !peakDone) {
+            currentPosition = position(this->active[current]);
+            double lastDiff = fabs(peak.interpolatedPosition - lastPosition);
+            double currentDiff = fabs(peak.interpolatedPosition - currentPosition);
+
+            // if the peak is still between the two histories, try to associate it with one
+            if (peak.interpolatedPosition < currentPosition) {
+                if (lastDiff <= maxBinJump || currentDiff <= maxBinJump) {  // the peak is near enough to one of the already existing peaks
+                    if (lastDiff < currentDiff) {
+                        if (peak.interpolatedPosition > lastPosition + 1) {
+                            std::cerr << "Warning: " << peak.timestamp.sec*1000 + peak.timestamp.msec() << ": " << peak.interpolatedPosition << " vs. " << lastPosition << "\n";
+                        } else {
+                            addPeak(history(last), peak);
+                            addedPeakToLast = true;
+                        }
+                    } else {
+                        addPeak(history(current), peak);
+                        addedPeakToCurrent = true;
+                    }
+                } else if (allowNew && peak.height >= newHistoryHeightThreshold) {  // the peak is not near enough, so start a new history if allowNew is set
+                    startHistory(peak);
+                } // else ignore peak
+                peakDone = true;
+            } else { // go one step further in the histories
+                if (!addedPeakToLast) {
+                    history(last).noPeak();
+                }
+                addedPeakToLast = addedPeakToCurrent;
+                addedPeakToCurrent = false;
+
+                lastPosition = currentPosition;
+                last = current;
+                ++current;
+            }
+        }
+
+        // the peak lies behind all histories, so it can only belong to the last one
+        if (!peakDone && last < count && fabs(peak.interpolatedPosition - lastPosition) <= maxBinJump) {
+            addPeak(history(last), peak);
+            addedPeakToLast = true;
+            peakDone = true;
+        }
+
+        if (!peakDone && allowNew && peak.height >= newHistoryHeightThreshold) {
+            startHistory(peak);
+        }
+    }
+
+    // the histories behind the last peak did not get a peak in this step either
+    for (; current < count; ++current) {
+        if (last != current && !addedPeakToLast) {
+            history(last).noPeak();
+        }
+        addedPeakToLast = addedPeakToCurrent;
+        addedPeakToCurrent = false;
+        last = current;
+    }
+    if (last < count && !addedPeakToLast) {
+        history(last).noPeak();
+    }
+}
+
+template<typename T> void PeakTracer<T>::assignOptimally(const Peak<T> *peaks, size_t peakCount, bool allowNew) {
+    size_t count = this->active.size();
+
+    // the peaks within maxBinJump of history i are lowerPeak[i] to upperPeak[i] - 1, both bounds never decrease with i
+    lowerPeak.resize(count);
+    upperPeak.resize(count);
+    size_t lower = 0, upper = 0;
+    for (size_t i = 0; i < count; ++i) {
+        double historyPosition = position(this->active[i]);
+        while (lower < peakCount && peaks[lower].interpolatedPosition < historyPosition - maxBinJump) {
+            lower++;
+        }
+        upper = std::max(upper, lower);
+        while (upper < peakCount && peaks[upper].interpolatedPosition <= historyPosition + maxBinJump) {
+            upper++;
+        }
+        lowerPeak[i] = lower;
+        upperPeak[i] = upper;
+    }
+
+    // Level i of the dynamic programming holds the best assignment of the histories before i to the peaks before j.
+    // It does not change any more for j >= upperPeak[i - 1], and it is only needed from lowerPeak[i - 1] on (the
+    // histories before i - 1 are no better with fewer peaks than they could use), so only this band is stored.
+    // Level i + 1 is calculated from lowerPeak[i] to upperPeak[i + 1] (upperPeak[i] for the last level).
+    auto better = [](const Assignment & a, const Assignment & b) -> bool {
+        return a.matches > b.matches || (a.matches == b.matches && a.distance < b.distance);
+    };
+    auto bandEnd = [this, count](size_t level) -> size_t {
+        return level < count ? upperPeak[level] : upperPeak[level - 1];
+    };
+    const Assignment none = {0, 0.0, SKIP_HISTORY};
+    auto cell = [this, &none, &bandEnd](size_t level, size_t j) -> const Assignment & {
+        if (level == 0) {
+            return none;
+        }
+        return cells[firstCell[level] + std::min(j, bandEnd(level)) - lowerPeak[level - 1]];
+    };
+
+    firstCell.resize(count + 1);
+    cells.clear();
+    for (size_t i = 0; i < count; ++i) {
+        double historyPosition = position(this->active[i]);
+        size_t begin = lowerPeak[i];
+        size_t end = bandEnd(i + 1);
+        firstCell[i + 1] = cells.size();
+        for (size_t j = begin; j <= end; ++j) {
+            Assignment best = cell(i, j);
+            best.choice = SKIP_HISTORY;
+            if (j > begin) {
+                const Assignment & withoutPeak = cells.back();
+                if (better(withoutPeak, best)) {
+                    best = withoutPeak;
+                    best.choice = SKIP_PEAK;
+                }
+                if (j - 1 < upperPeak[i]) {
+                    Assignment match = cell(i, j - 1);
+                    match.matches++;
+                    match.distance += fabs(peaks[j - 1].interpolatedPosition - historyPosition);
+                    if (better(match, best)) {
+                        best = match;
+                        best.choice = MATCH;
+                    }
+                }
+            }
+            cells.push_back(best);
+        }
+    }
+
+    // follow the choices back from the last level
+    matchedPeak.assign(count, peakCount);
+    peakMatched.assign(peakCount, false);
+    size_t level = count;
+    size_t j = count > 0 ? bandEnd(count) : 0;
+    while (level > 0) {
+        switch (cell(level, j).choice) {
+            case MATCH:
+                matchedPeak[level - 1] = j - 1;
+                peakMatched[j - 1] = true;
+                j--;
+                level--;
+                break;
+            case SKIP_PEAK:
+                j--;
+                break;
+            default:
+                level--;
+                if (level > 0) {
+                    j = std::min(j, bandEnd(level));
+                }
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (matchedPeak[i] < peakCount) {
+            addPeak(history(i), peaks[matchedPeak[i]]);
+        } else {
+            history(i).noPeak();
+        }
+    }
+
+    // the remaining peaks start new histories if they are not near any history
+    if (!allowNew) {
+        return;
+    }
+    size_t i = 0;
+    for (size_t p = 0; p < peakCount; ++p) {
+        while (i < count && upperPeak[i] <= p) {
+            i++;
+        }
+        bool nearHistory = i < count && lowerPeak[i] <= p;
+        if (!peakMatched[p] && !nearHistory && peaks[p].height >= newHistoryHeightThreshold) {
+            startHistory(peaks[p]);
+        }
+    }
+}
+
+template<typename T> void PeakTracer<T>::addPeak(PeakHistory<T> & history, const Peak<T> & peak) {
+    const Peak<T> *dropped = history.addPeak(this->pool.acquire(peak));
+    if (dropped) {
+        this->pool.release(dropped);
+    }
+}
+
+template<typename T> void PeakTracer<T>::startHistory(const Peak<T> & peak) {
+    const Peak<T> *initialPeak = this->pool.acquire(peak);
+    if (this->freeSlots.empty()) {
+        this->added.push_back(this->histories.size());
+        this->histories.emplace_back(broadestAllowedInterruption, maxHistoryLength);
+    } else {
+        this->added.push_back(this->freeSlots.back());
+        this->freeSlots.pop_back();
+    }
+    this->histories[this->added.back()].restart(initialPeak);
+}
+
+template<typename T> void PeakTracer<T>::removeDeadHistories(bool keepStable) {
+    size_t kept = 0;
+    for (size_t i = 0; i < this->active.size(); ++i) {
+        size_t slot = this->active[i];
+        if (this->histories[slot].isAlive(keepStable)) {
+            this->active[kept++] = slot;
+        } else {
+            this->histories[slot].releasePeaks(this->pool);
+            this->freeSlots.push_back(slot);
+        }
+    }
+    this->active.resize(kept);
+}
+
+template<typename T> void PeakTracer<T>::sortHistories() {
+    // insertion sort, the positions of the histories moved by at most the maximum bin jump since the last step
+    for (size_t i = 1; i < this->active.size(); ++i) {
+        size_t slot = this->active[i];
+        double slotPosition = position(slot);
+        size_t j = i;
+        while (j > 0 && position(this->active[j - 1]) > slotPosition) {
+            this->active[j] = this->active[j - 1];
+            --j;
+        }
+        this->active[j] = slot;
+    }
+
+    if (this->added.empty()) {
+        return;
+    }
+    this->merged.clear();
+    std::merge(this->active.begin(), this->active.end(), this->added.begin(), this->added.end(), std::back_inserter(this->merged),
+               [this](size_t a, size_t b) -> bool {
+                   return position(a) < position(b);
+               });
+    this->active.swap(this->merged);
+}
+
+
+// template initializations
+template class PeakTracer<float>;
+template class PeakTracer<double>;
@@ -0,0 +1,142 @@
+//
+//  PeakTracer.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef PeakTracer_hpp
+#define PeakTracer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include "PeakFinder.hpp"
+#include "PeakHistory.hpp"
+
+// PeakTracer traces peaks over time by assigning the peaks of each step to the peak history with the nearest position.
+// The histories are stored in slots which are reused once a history died, so the store does not shrink or get reallocated
+// in the steady state. The order of the histories by position is kept in a list of slot indices: after each step the
+// surviving histories are re-sorted by an insertion pass (their positions only move a little, so it is nearly sorted) and
+// merged with the new histories, which are sorted already as the peaks are. A step therefore costs O(peaks + histories).
+//
+// There are two ways to assign the peaks to the histories:
+// - greedyMode walks through the peaks and histories at once and only compares each peak with the two histories around it.
+//   Peaks which lie between two histories but nearer to the lower one by more than a bin are dropped with a warning.
+// - assignmentMode finds the assignment of at most one peak per history which matches as many histories as possible
+//   and has the smallest total distance among those (peaks further away than maxBinJump can't be matched). As both are
+//   sorted by position, the best assignment does not cross, so it is found by dynamic programming over the histories,
+//   which only looks at the peaks within maxBinJump of each history and is therefore about linear too.
+template<typename T> class PeakTracer {
+
+public:
+    enum Mode {
+        greedyMode,
+        assignmentMode
+    };
+
+    PeakTracer();
+
+    // sets the parameters of the tracing and forgets all histories
+    // peaks are only assigned to histories whose last peak is at most maxBinJump away, new histories need peaks
+    // of at least newHistoryHeightThreshold height, and histories keep up to maxHistoryLength peaks (0 for all)
+    void initialise(double maxBinJump, size_t broadestAllowedInterruption, size_t maxHistoryLength, T newHistoryHeightThreshold,
+                    Mode mode = greedyMode);
+
+    // forgets all histories and peaks
+    void reset();
+
+    // assigns the peaks of a step (sorted by position) to the histories, histories which got no peak miss one
+    // if allowNew is set, peaks which fit no history start new ones. Afterwards visit is called with every history
+    // which existed before this step, then the histories which are not alive (see PeakHistory::isAlive) are removed.
+    template<class Visit>
+    void trace(const Peak<T> *peaks, size_t peakCount, bool allowNew, bool keepStable, Visit visit);
+
+    // number of histories
+    size_t size() const {
+        return this->active.size();
+    }
+
+    // the i-th history ordered by the position of the last peak
+    PeakHistory<T> & operator[](size_t i) {
+        return this->histories[this->active[i]];
+    }
+
+private:
+    PeakHistory<T> & history(size_t i) {
+        return this->histories[this->active[i]];
+    }
+
+    double position(size_t slot) const {
+        return this->histories[slot].getLast()->interpolatedPosition;
+    }
+
+    // assigns the peaks to the histories like described for greedyMode, all histories which got no peak miss one
+    void assignGreedily(const Peak<T> *peaks, size_t peakCount, bool allowNew);
+
+    // assigns the peaks to the histories like described for assignmentMode, all histories which got no peak miss one
+    // unmatched peaks only start new histories if they are not within maxBinJump of any history
+    void assignOptimally(const Peak<T> *peaks, size_t peakCount, bool allowNew);
+
+    // copies the peak to the pool and adds it to the history, a peak dropped by the history goes back to the pool
+    void addPeak(PeakHistory<T> & history, const Peak<T> & peak);
+
+    // starts a new history with the peak in a free slot
+    void startHistory(const Peak<T> & peak);
+
+    // removes the histories which are not alive, gives their peaks back and frees their slots
+    void removeDeadHistories(bool keepStable);
+
+    // restores the order by position of the remaining histories and merges them with the new ones
+    void sortHistories();
+
+    double maxBinJump;
+    size_t broadestAllowedInterruption;
+    size_t maxHistoryLength;
+    T newHistoryHeightThreshold;
+    Mode mode;
+
+    // owns all peaks of the histories
+    PeakFinder::PeakPool<T> pool;
+
+    // all slots, only those listed in active contain histories
+    std::vector<PeakHistory<T>> histories;
+    std::vector<size_t> freeSlots;
+
+    // slots of the histories ordered by position, new histories of the current step and scratch space for merging them
+    std::vector<size_t> active;
+    std::vector<size_t> added;
+    std::vector<size_t> merged;
+
+    // scratch space of assignOptimally
+    struct Assignment {
+        size_t matches;
+        double distance;
+        unsigned char choice;
+    };
+    std::vector<size_t> lowerPeak;
+    std::vector<size_t> upperPeak;
+    std::vector<size_t> firstCell;
+    std::vector<Assignment> cells;
+    std::vector<size_t> matchedPeak;
+    std::vector<char> peakMatched;
+};
+
+/////////// implementation of template functions
+
+template<typename T> template<class Visit>
+void PeakTracer<T>::trace(const Peak<T> *peaks, size_t peakCount, bool allowNew, bool keepStable, Visit visit) {
+    // the new histories are collected separately, so the histories which existed before are still the active ones
+    this->added.clear();
+    if (this->mode == assignmentMode) {
+        assignOptimally(peaks, peakCount, allowNew);
+    } else {
+        assignGreedily(peaks, peakCount, allowNew);
+    }
+
+    for (size_t i = 0; i < this->active.size(); ++i) {
+        visit(history(i));
+    }
+
+    removeDeadHistories(keepStable);
+    sortHistories();
+}
+
+#endif /* PeakTracer_hpp */
@@ -0,0 +1,229 @@
+//
+//  Replay.cpp
+//  wunderwelt-vamp-plugin
+//
+//  Analyses the averaged spectra of a spectrum dump again for a grid of parameter sets and prints the speeds found with
+//  each of them. The spectra are read from the mapped dump by all threads, so only the peak finding and tracing is
+//  repeated per parameter set.
+//
+
+#include "DopplerSpeedCalculator.hpp"
+#include "SpectrumDump.hpp"
+#include "WorkerPool.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+
+using std::string;
+using std::vector;
+using std::map;
+using Vamp::RealTime;
+
+// the parameters which shape the averaged spectra or the files written, they can't be changed in a replay
+static const std::set<string> fixedParameters = {
+    DEBUG_CSV_FILES, SPECTRUM_DUMP_ID, MOVING_FFT_AVERAGE_WIDTH_ID, AVERAGING_DOMAIN_ID, CHANNEL_MODE_ID
+};
+
+struct Axis {
+    string identifier;
+    vector<float> values;
+};
+
+struct Result {
+    bool valid;
+    vector<Vamp::Plugin::Feature> speeds;
+};
+
+static void printUsage() {
+    std::cerr << "usage: wunderwelt-replay [-j threads] <spectrum.dump> [<parameter>=<values>]...\n"
+                 "  the values are a comma separated list (e.g. max-bin-jump=3,5,8)\n"
+                 "  or a range start:stop:step (e.g. peak-tracing-height-threshold=3:9:1)\n"
+                 "  every combination of the values is analysed, the speeds are written to stdout as csv\n";
+}
+
+// parses an argument of the form parameter=values, returns false if it is malformed
+static bool parseAxis(const string & argument, Axis & axis) {
+    size_t equals = argument.find('=');
+    if (equals == string::npos || equals == 0) {
+        return false;
+    }
+    axis.identifier = argument.substr(0, equals);
+    string values = argument.substr(equals + 1);
+
+    float start, stop, step;
+    char separator1, separator2;
+    std::istringstream range(values);
+    if (values.find(':') != string::npos) {
+        if (!(range >> start >> separator1 >> stop >> separator2 >> step) || separator1 != ':' || separator2 != ':' || step <= 0) {
+            return false;
+        }
+        // the stop value is included even if the steps don't add up to it exactly
+        for (size_t i = 0; start + i * step <= stop + step * 1e-3; ++i) {
+            axis.values.push_back(start + i * step);
+        }
+    } else {
+        std::istringstream list(values);
+        string value;
+        while (std::getline(list, value, ',')) {
+            char *end;
+            axis.values.push_back(strtof(value.c_str(), &end));
+            if (value.empty() || *end != '\0') {
+                return false;
+            }
+        }
+    }
+    return !axis.values.empty();
+}
+
+// replays all steps of the dump with the given parameters and collects the speeds
+static Result replay(const SpectrumDumpReader & dump, const vector<size_t> & steps, const map<string, float> & parameters) {
+    const SpectrumDumpHeader & header = dump.getHeader();
+    Result result;
+    result.valid = false;
+
+    DopplerSpeedCalculator calculator(header.sampleRate);
+    for (auto& parameter : dump.getParameters()) {
+        calculator.setParameter(parameter.first, parameter.second);
+    }
+    for (auto& parameter : parameters) {
+        calculator.setParameter(parameter.first, parameter.second);
+    }
+    calculator.setParameter(DEBUG_CSV_FILES, 0);
+    calculator.setParameter(SPECTRUM_DUMP_ID, 0);
+    // the parameter sets are already spread over the threads (as many as -j allows), more threads per calculator for
+    // its channels would only compete with them
+    calculator.setParallelChannels(false);
+
+    int speedOutput = -1;
+    DopplerSpeedCalculator::OutputList outputs = calculator.getOutputDescriptors();
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (outputs[i].identifier == "naive-speed-of-source") {
+            speedOutput = (int) i;
+        }
+    }
+    if (!calculator.initialiseSpectrumReplay(header)) {
+        return result;
+    }
+    result.valid = true;
+
+    vector<const float *> spectra(header.spectraPerStep);
+    for (size_t s = 0; s + 1 < steps.size(); ++s) {
+        for (size_t frame = steps[s]; frame < steps[s + 1]; ++frame) {
+            spectra[dump.getFrame(frame).channel % header.spectraPerStep] = dump.getSpectrum(frame);
+        }
+        DopplerSpeedCalculator::FeatureSet features = calculator.processSpectrum(spectra.data(), dump.getTimestamp(steps[s]));
+        result.speeds.insert(result.speeds.end(), features[speedOutput].begin(), features[speedOutput].end());
+    }
+    DopplerSpeedCalculator::FeatureSet features = calculator.getRemainingFeatures();
+    result.speeds.insert(result.speeds.end(), features[speedOutput].begin(), features[speedOutput].end());
+    return result;
+}
+
+int main(int argc, char **argv) {
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    string path;
+    vector<Axis> axes;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "-j" && i + 1 < argc) {
+            threads = std::max(atoi(argv[++i]), 1);
+        } else if (path.empty() && argument.find('=') == string::npos) {
+            path = argument;
+        } else {
+            Axis axis;
+            if (!parseAxis(argument, axis)) {
+                std::cerr << "ERROR: invalid parameter values " << argument << "\n";
+                printUsage();
+                return 1;
+            }
+            axes.push_back(axis);
+        }
+    }
+    if (path.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    SpectrumDumpReader dump;
+    if (!dump.open(path)) {
+        std::cerr << "ERROR: " << path << " is no valid spectrum dump\n";
+        return 1;
+    }
+    const SpectrumDumpHeader & header = dump.getHeader();
+
+    // only the parameters of the plugin can be varied, and not the ones which shaped the dumped spectra
+    DopplerSpeedCalculator::ParameterList descriptors = DopplerSpeedCalculator(header.sampleRate).getParameterDescriptors();
+    for (auto& axis : axes) {
+        bool known = false;
+        for (auto& descriptor : descriptors) {
+            known = known || descriptor.identifier == axis.identifier;
+        }
+        if (!known || fixedParameters.count(axis.identifier) > 0) {
+            std::cerr << "ERROR: parameter " << axis.identifier << " can't be varied in a replay\n";
+            return 1;
+        }
+    }
+
+    // the frames of a step have the same timestamp, steps[s] is the first frame of step s
+    vector<size_t> steps;
+    for (size_t frame = 0; frame < dump.getFrameCount(); ++frame) {
+        if (frame == 0 || dump.getTimestamp(frame) != dump.getTimestamp(frame - 1)) {
+            steps.push_back(frame);
+        }
+    }
+    steps.push_back(dump.getFrameCount());
+
+    // every combination of the values of the axes, the last axis changes fastest
+    vector<map<string, float>> parameterSets(1);
+    for (auto& axis : axes) {
+        vector<map<string, float>> combined;
+        for (auto& parameters : parameterSets) {
+            for (float value : axis.values) {
+                combined.push_back(parameters);
+                combined.back()[axis.identifier] = value;
+            }
+        }
+        parameterSets.swap(combined);
+    }
+
+    vector<Result> results(parameterSets.size());
+    auto job = [&](size_t i) {
+        results[i] = replay(dump, steps, parameterSets[i]);
+    };
+    WorkerPool workers;
+    workers.start(std::min(threads, parameterSets.size()) - 1);
+    workers.run(parameterSets.size(), job);
+    workers.stop();
+
+    std::cout << "set";
+    for (auto& axis : axes) {
+        std::cout << ";" << axis.identifier;
+    }
+    std::cout << ";speeds (km/h)\n";
+    for (size_t i = 0; i < parameterSets.size(); ++i) {
+        std::cout << i;
+        for (auto& axis : axes) {
+            std::cout << ";" << parameterSets[i][axis.identifier];
+        }
+        std::cout << ";";
+        if (!results[i].valid) {
+            std::cout << "invalid parameters";
+        }
+        for (size_t s = 0; s < results[i].speeds.size(); ++s) {
+            const Vamp::Plugin::Feature & speed = results[i].speeds[s];
+            std::cout << (s > 0 ? " " : "") << speed.values[0];
+            if (!speed.label.empty()) {
+                std::cout << " (" << speed.label << ")";
+            }
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
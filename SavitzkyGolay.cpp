@@ -0,0 +1,117 @@
+//
+//  SavitzkyGolay.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "SavitzkyGolay.hpp"
+#include "VectorKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+SavitzkyGolay::SavitzkyGolay():
+    halfWidth(0),
+    order(0),
+    coefficients(std::vector<float>(1, 1.0f)) {
+}
+
+void SavitzkyGolay::initialise(size_t halfWidth, size_t order) {
+    this->halfWidth = halfWidth;
+    this->order = std::min(order, 2 * halfWidth);
+
+    size_t length = getWindowLength();
+    this->coefficients.assign(length * length, 0);
+    for (int offset = -(int) halfWidth; offset <= (int) halfWidth; ++offset) {
+        calculateCoefficients(offset, &this->coefficients[(offset + halfWidth) * length]);
+    }
+}
+
+void SavitzkyGolay::calculateCoefficients(int offset, float *output) const {
+    // The fitted value at t is e(t)^T (J^T J)^-1 J^T y, where J contains the powers of the positions in the window and
+    // e(t) the powers of t, so the coefficients are J a with (J^T J) a = e(t). The positions are scaled to [-1, 1]
+    // (which doesn't change the coefficients) to keep the normal equations well conditioned.
+    size_t length = getWindowLength();
+    size_t terms = this->order + 1;
+    double scale = this->halfWidth > 0 ? 1.0 / this->halfWidth : 1.0;
+
+    // normal equations as augmented matrix, (J^T J)_pq is the sum of x^(p+q) over the positions x
+    std::vector<double> matrix(terms * (terms + 1), 0);
+    for (size_t k = 0; k < length; ++k) {
+        double x = ((double) k - this->halfWidth) * scale;
+        for (size_t p = 0; p < terms; ++p) {
+            for (size_t q = 0; q < terms; ++q) {
+                matrix[p * (terms + 1) + q] += std::pow(x, (double) (p + q));
+            }
+        }
+    }
+    for (size_t p = 0; p < terms; ++p) {
+        matrix[p * (terms + 1) + terms] = std::pow(offset * scale, (double) p);
+    }
+
+    // gaussian elimination with partial pivoting
+    for (size_t column = 0; column < terms; ++column) {
+        size_t pivot = column;
+        for (size_t row = column + 1; row < terms; ++row) {
+            if (fabs(matrix[row * (terms + 1) + column]) > fabs(matrix[pivot * (terms + 1) + column])) {
+                pivot = row;
+            }
+        }
+        for (size_t i = 0; i <= terms; ++i) {
+            std::swap(matrix[column * (terms + 1) + i], matrix[pivot * (terms + 1) + i]);
+        }
+        for (size_t row = column + 1; row < terms; ++row) {
+            double factor = matrix[row * (terms + 1) + column] / matrix[column * (terms + 1) + column];
+            for (size_t i = column; i <= terms; ++i) {
+                matrix[row * (terms + 1) + i] -= factor * matrix[column * (terms + 1) + i];
+            }
+        }
+    }
+    std::vector<double> a(terms, 0);
+    for (size_t row = terms; row > 0; --row) {
+        double sum = matrix[(row - 1) * (terms + 1) + terms];
+        for (size_t i = row; i < terms; ++i) {
+            sum -= matrix[(row - 1) * (terms + 1) + i] * a[i];
+        }
+        a[row - 1] = sum / matrix[(row - 1) * (terms + 1) + row - 1];
+    }
+
+    for (size_t k = 0; k < length; ++k) {
+        double x = ((double) k - this->halfWidth) * scale;
+        double coefficient = 0;
+        for (size_t p = 0; p < terms; ++p) {
+            coefficient += a[p] * std::pow(x, (double) p);
+        }
+        output[k] = coefficient;
+    }
+}
+
+void SavitzkyGolay::apply(const float *input, float *output, size_t n) const {
+    size_t length = getWindowLength();
+    if (!isEnabled() || n < length) {
+        memcpy(output, input, n * sizeof(float));
+        return;
+    }
+
+    // inner values: convolution with the coefficients of the window center, tap by tap over all values at once
+    const float *center = getCoefficients(0);
+    size_t inner = n - 2 * halfWidth;
+    std::fill(output + halfWidth, output + n - halfWidth, 0.0f);
+    for (size_t k = 0; k < length; ++k) {
+        VectorKernels::multiplyAdd(input + k, output + halfWidth, inner, center[k]);
+    }
+
+    // the first and last values are evaluated from the first and last window
+    const float *lastWindow = input + n - length;
+    for (size_t i = 0; i < halfWidth; ++i) {
+        const float *first = getCoefficients((int) i - (int) halfWidth);
+        const float *last = getCoefficients((int) (i + 1));
+        float firstSum = 0, lastSum = 0;
+        for (size_t k = 0; k < length; ++k) {
+            firstSum += first[k] * input[k];
+            lastSum += last[k] * lastWindow[k];
+        }
+        output[i] = firstSum;
+        output[n - halfWidth + i] = lastSum;
+    }
+}
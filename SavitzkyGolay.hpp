@@ -0,0 +1,59 @@
+//
+//  SavitzkyGolay.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef SavitzkyGolay_hpp
+#define SavitzkyGolay_hpp
+
+#include <stdio.h>
+#include <vector>
+
+// SavitzkyGolay smooths data (e.g. a spectrum) by fitting a polynomial of a given order to the values in a window around each
+// value by least squares and replacing the value by the fitted one. In contrast to a moving average, peaks keep their
+// height and position much better. The fits are linear in the data, so they are convolutions with coefficients which are
+// calculated once in initialise. The first and last halfWidth values are fitted with the polynomial of the first and last
+// whole window, which needs an extra set of coefficients for each of these positions.
+class SavitzkyGolay {
+
+public:
+    SavitzkyGolay();
+
+    // prepares the coefficients for windows of 2 * halfWidth + 1 values and polynomials of the given order
+    // the order is reduced to 2 * halfWidth if it is higher, a halfWidth of 0 disables the smoothing
+    void initialise(size_t halfWidth, size_t order);
+
+    // writes the smoothed n values of input to output, which must not overlap with input
+    // if n is smaller than the window, the values are copied unchanged
+    void apply(const float *input, float *output, size_t n) const;
+
+    // the coefficients to evaluate the fit at offset (from -halfWidth to halfWidth) from the center of a window
+    // the returned array has 2 * halfWidth + 1 values, which belong to the values of the window in ascending order
+    const float* getCoefficients(int offset) const {
+        return &this->coefficients[(offset + this->halfWidth) * getWindowLength()];
+    }
+
+    bool isEnabled() const {
+        return this->halfWidth > 0;
+    }
+
+    size_t getWindowLength() const {
+        return 2 * this->halfWidth + 1;
+    }
+
+    size_t getOrder() const {
+        return this->order;
+    }
+
+private:
+    // calculates the coefficients of the least squares fit evaluated at offset and writes them to output
+    void calculateCoefficients(int offset, float *output) const;
+
+    size_t halfWidth;
+    size_t order;
+
+    // getWindowLength() sets of getWindowLength() coefficients, ordered by the offset they belong to
+    std::vector<float> coefficients;
+};
+
+#endif /* SavitzkyGolay_hpp */
@@ -0,0 +1,173 @@
+//
+//  SpectrumDump.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "SpectrumDump.hpp"
+#include <iostream>
+#include <string.h>
+
+
+// rounds a size up to the next multiple of 8, which all sections of the file start at
+static uint64_t align(uint64_t size) {
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+SpectrumDumpWriter::SpectrumDumpWriter():
+    file(nullptr),
+    header(SpectrumDumpHeader()) {
+}
+
+SpectrumDumpWriter::~SpectrumDumpWriter() {
+    close();
+}
+
+bool SpectrumDumpWriter::open(const std::string & path, const SpectrumDumpHeader & header,
+                              const std::map<std::string, float> & parameters) {
+    close();
+
+    this->file = fopen(path.c_str(), "wb");
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    this->header = header;
+    memcpy(this->header.magic, SPECTRUM_DUMP_MAGIC, sizeof(this->header.magic));
+    this->header.version = SPECTRUM_DUMP_VERSION;
+    this->header.parameterCount = (uint32_t) parameters.size();
+    this->header.frameStride = (uint32_t) align(sizeof(SpectrumDumpFrame) + header.frameSize * sizeof(float));
+    this->header.frameOffset = sizeof(SpectrumDumpHeader) + parameters.size() * sizeof(SpectrumDumpParameter);
+    this->header.frameCount = 0;
+    this->header.framesEnd = 0;
+    this->header.peakCount = 0;
+    this->padding.assign(this->header.frameStride - sizeof(SpectrumDumpFrame) - header.frameSize * sizeof(float), 0);
+
+    // the header is written again with the final counts when the dump is closed
+    if (!write(&this->header, sizeof(SpectrumDumpHeader))) {
+        return false;
+    }
+    for (auto& parameter : parameters) {
+        SpectrumDumpParameter entry = SpectrumDumpParameter();
+        strncpy(entry.identifier, parameter.first.c_str(), SPECTRUM_DUMP_IDENTIFIER_LENGTH - 1);
+        entry.value = parameter.second;
+        if (!write(&entry, sizeof(SpectrumDumpParameter))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SpectrumDumpWriter::addFrame(size_t channel, _VampPlugin::Vamp::RealTime timestamp, const float *spectrum,
+                                  const PeakFinder::Peak<float> *peaks, size_t peakCount) {
+    SpectrumDumpFrame frame = SpectrumDumpFrame();
+    frame.channel = (uint32_t) channel;
+    frame.peakCount = (uint32_t) peakCount;
+    frame.sec = timestamp.sec;
+    frame.nsec = timestamp.nsec;
+
+    this->peaks.resize(peakCount);
+    for (size_t p = 0; p < peakCount; ++p) {
+        SpectrumDumpPeak & peak = this->peaks[p];
+        peak = SpectrumDumpPeak();
+        peak.interpolatedPosition = peaks[p].interpolatedPosition;
+        peak.position = (uint32_t) peaks[p].position;
+        peak.value = peaks[p].value;
+        peak.height = peaks[p].height;
+    }
+
+    if (!write(&frame, sizeof(SpectrumDumpFrame)) || !write(spectrum, this->header.frameSize * sizeof(float)) ||
+        !write(this->padding.data(), this->padding.size()) || !write(this->peaks.data(), peakCount * sizeof(SpectrumDumpPeak))) {
+        std::cerr << "WARNING: could not write the spectrum dump, it was closed incomplete\n";
+        return;
+    }
+    this->header.frameCount++;
+    this->header.peakCount += peakCount;
+}
+
+void SpectrumDumpWriter::close() {
+    if (this->file == nullptr) {
+        return;
+    }
+
+    this->header.framesEnd = this->header.frameOffset + this->header.frameCount * this->header.frameStride +
+        this->header.peakCount * sizeof(SpectrumDumpPeak);
+    bool written = fseek(this->file, 0, SEEK_SET) == 0 && fwrite(&this->header, sizeof(SpectrumDumpHeader), 1, this->file) == 1;
+    // buffered frames may only fail to be written now
+    written = fclose(this->file) == 0 && written;
+    this->file = nullptr;
+    if (!written) {
+        std::cerr << "WARNING: could not complete the spectrum dump\n";
+    }
+}
+
+bool SpectrumDumpWriter::write(const void *data, size_t size) {
+    if (fwrite(data, 1, size, this->file) != size) {
+        // the header still says that the dump is incomplete
+        fclose(this->file);
+        this->file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+
+SpectrumDumpReader::SpectrumDumpReader():
+    file(),
+    frameOffsets() {
+}
+
+bool SpectrumDumpReader::open(const std::string & path) {
+    close();
+    if (!this->file.open(path)) {
+        return false;
+    }
+
+    // check that the header is valid and all sections are inside the file
+    const SpectrumDumpHeader & header = getHeader();
+    size_t size = this->file.getSize();
+    bool valid = size >= sizeof(SpectrumDumpHeader) &&
+        memcmp(header.magic, SPECTRUM_DUMP_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == SPECTRUM_DUMP_VERSION &&
+        header.frameStride >= sizeof(SpectrumDumpFrame) + header.frameSize * sizeof(float) &&
+        header.frameOffset >= sizeof(SpectrumDumpHeader) + header.parameterCount * sizeof(SpectrumDumpParameter) &&
+        header.framesEnd >= header.frameOffset && header.framesEnd <= size &&
+        header.frameCount <= (header.framesEnd - header.frameOffset) / header.frameStride;
+
+    // the frames have to fill the space up to framesEnd exactly
+    uint64_t offset = header.frameOffset;
+    uint64_t peakCount = 0;
+    if (valid) {
+        this->frameOffsets.reserve(header.frameCount);
+    }
+    for (size_t frame = 0; valid && frame < header.frameCount; ++frame) {
+        valid = offset + header.frameStride <= header.framesEnd;
+        if (valid) {
+            this->frameOffsets.push_back(offset);
+            uint64_t peaks = reinterpret_cast<const SpectrumDumpFrame *>(this->file.getData() + offset)->peakCount;
+            offset += header.frameStride + peaks * sizeof(SpectrumDumpPeak);
+            peakCount += peaks;
+        }
+    }
+    valid = valid && offset == header.framesEnd && peakCount == header.peakCount;
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+std::map<std::string, float> SpectrumDumpReader::getParameters() const {
+    std::map<std::string, float> parameters;
+    const SpectrumDumpParameter *entries = reinterpret_cast<const SpectrumDumpParameter *>(this->file.getData() + sizeof(SpectrumDumpHeader));
+    for (size_t i = 0; i < getHeader().parameterCount; ++i) {
+        std::string identifier(entries[i].identifier, strnlen(entries[i].identifier, SPECTRUM_DUMP_IDENTIFIER_LENGTH));
+        parameters[identifier] = entries[i].value;
+    }
+    return parameters;
+}
+
+const SpectrumDumpPeak* SpectrumDumpReader::getPeaks(size_t frame, size_t & count) const {
+    // the peaks follow the fixed part of the frame
+    const SpectrumDumpFrame & data = getFrame(frame);
+    count = data.peakCount;
+    return reinterpret_cast<const SpectrumDumpPeak *>(reinterpret_cast<const char *>(&data) + getHeader().frameStride);
+}
@@ -0,0 +1,161 @@
+//
+//  SpectrumDump.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef SpectrumDump_hpp
+#define SpectrumDump_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <vamp-sdk/RealTime.h>
+
+#include "MappedFile.hpp"
+#include "PeakFinder.hpp"
+
+# define SPECTRUM_DUMP_MAGIC "WWSPDUMP"
+# define SPECTRUM_DUMP_VERSION 2
+# define SPECTRUM_DUMP_IDENTIFIER_LENGTH 48
+
+// A spectrum dump holds the averaged spectra of an analysis and the peaks found in them, so the later stages can be
+// run again with other parameters without calculating the spectra again. The file consists of (all values in the byte
+// order of the machine which wrote it, all sections start at multiples of 8 bytes):
+// - a SpectrumDumpHeader,
+// - parameterCount SpectrumDumpParameters with the values of all parameters of the plugin,
+// - frameCount frames one after the other, starting at frameOffset and ending at framesEnd. A frame consists of
+//   frameStride bytes with a SpectrumDumpFrame and the frameSize values of the spectrum in dB (the first frameSize
+//   values of the zero-padded spectrum, so the bins are every paddingFactor-th value), followed by the peakCount
+//   SpectrumDumpPeaks of the frame in ascending order of their positions.
+// frameCount, framesEnd and peakCount are only set when the dump is closed, so a dump which wasn't completed has
+// framesEnd 0 and is rejected by the reader.
+struct SpectrumDumpHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t parameterCount;
+    float sampleRate;
+    uint32_t blockSize;
+    uint32_t stepSize;
+    uint32_t fftSize;
+    uint32_t paddingFactor;
+    uint32_t frameSize;
+    uint32_t frameStride;
+    uint32_t spectraPerStep;
+    uint64_t frameOffset;
+    uint64_t frameCount;
+    uint64_t framesEnd;
+    uint64_t peakCount;
+};
+
+struct SpectrumDumpParameter {
+    char identifier[SPECTRUM_DUMP_IDENTIFIER_LENGTH];
+    float value;
+    uint32_t reserved;
+};
+
+struct SpectrumDumpFrame {
+    // the channel the spectrum belongs to (the first one if the channels are combined)
+    uint32_t channel;
+    uint32_t peakCount;
+    int32_t sec;
+    int32_t nsec;
+};
+
+struct SpectrumDumpPeak {
+    double interpolatedPosition;
+    uint32_t position;
+    float value;
+    float height;
+    uint32_t reserved;
+};
+
+// SpectrumDumpWriter writes each frame with its peaks while the analysis runs, so its memory doesn't grow with the
+// length of the analysis. If writing fails, a warning is printed and the file is closed without completing the header.
+class SpectrumDumpWriter {
+
+public:
+    SpectrumDumpWriter();
+    ~SpectrumDumpWriter();
+
+    // creates the file and writes the header, the fields describing the frames and peaks are set by the writer
+    // a dump which was opened before is closed first; returns false if the file can't be created
+    bool open(const std::string & path, const SpectrumDumpHeader & header, const std::map<std::string, float> & parameters);
+
+    // completes the header and closes the file
+    void close();
+
+    bool isOpen() const {
+        return this->file != nullptr;
+    }
+
+    // appends a frame with frameSize values of the spectrum and its peaks, the dump is closed if it can't be written
+    void addFrame(size_t channel, _VampPlugin::Vamp::RealTime timestamp, const float *spectrum,
+                  const PeakFinder::Peak<float> *peaks, size_t peakCount);
+
+private:
+    // writes size bytes, if that fails the dump is given up; returns whether the file is still open
+    bool write(const void *data, size_t size);
+
+    FILE *file;
+    SpectrumDumpHeader header;
+    std::vector<char> padding;
+
+    // the peaks of the current frame in the format of the file
+    std::vector<SpectrumDumpPeak> peaks;
+};
+
+// SpectrumDumpReader maps a dump into memory, so the frames are read directly from the file without copying them.
+// As the frames differ in length by their peaks, their offsets are collected when the dump is opened.
+class SpectrumDumpReader {
+
+public:
+    SpectrumDumpReader();
+
+    // maps the file and checks its header, a dump which was opened before is closed first
+    // returns false if the file can't be mapped or is no complete dump
+    bool open(const std::string & path);
+
+    void close() {
+        this->file.close();
+        this->frameOffsets.clear();
+    }
+
+    bool isOpen() const {
+        return this->file.isOpen();
+    }
+
+    const SpectrumDumpHeader & getHeader() const {
+        return *reinterpret_cast<const SpectrumDumpHeader *>(this->file.getData());
+    }
+
+    // the values of the parameters the dump was written with
+    std::map<std::string, float> getParameters() const;
+
+    size_t getFrameCount() const {
+        return getHeader().frameCount;
+    }
+
+    const SpectrumDumpFrame & getFrame(size_t frame) const {
+        return *reinterpret_cast<const SpectrumDumpFrame *>(this->file.getData() + this->frameOffsets[frame]);
+    }
+
+    _VampPlugin::Vamp::RealTime getTimestamp(size_t frame) const {
+        return _VampPlugin::Vamp::RealTime(getFrame(frame).sec, getFrame(frame).nsec);
+    }
+
+    // the frameSize values of the spectrum of a frame
+    const float* getSpectrum(size_t frame) const {
+        return reinterpret_cast<const float *>(&getFrame(frame) + 1);
+    }
+
+    // the peaks of a frame, count is set to their number
+    const SpectrumDumpPeak* getPeaks(size_t frame, size_t & count) const;
+
+private:
+    MappedFile file;
+    std::vector<uint64_t> frameOffsets;
+};
+
+#endif /* SpectrumDump_hpp */
@@ -0,0 +1,1045 @@
+//
+//  Tests.cpp
+//  wunderwelt-vamp-plugin
+//
+//  Regression tests of the building blocks of the plugins. Every test prints a line with ok or FAILED and the checks
+//  which failed; the exit code is 1 if a test failed. Only the tests whose name contains the given filter are run.
+//
+
+#include "AmplitudeFollower.hpp"
+#include "AsyncCsvWriter.hpp"
+#include "DopplerSpeedCalculator.hpp"
+#include "EnvelopeFollower.hpp"
+#include "HalfBandDecimator.hpp"
+#include "MovingAverage.hpp"
+#include "PeakHistory.hpp"
+#include "PeakTracer.hpp"
+#include "SavitzkyGolay.hpp"
+#include "SpectrumDump.hpp"
+#include "TimeDomainDopplerSpeedCalculator.hpp"
+#include "VectorKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+// all allocations of the process are counted, so that tests can check that a piece of code doesn't allocate
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations++;
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+# define TEST_SAMPLE_RATE 44100.0f
+
+namespace {
+
+    struct Test {
+        string name;
+        std::function<void()> run;
+    };
+
+    // the number of failed checks of the running test
+    size_t failures = 0;
+
+    void check(bool condition, const string & message) {
+        if (!condition) {
+            if (failures < 10) {
+                std::cout << "#   " << message << "\n";
+            }
+            failures++;
+        }
+    }
+
+    // the sums of a moving average are compared to the ones calculated from scratch after every frame
+    void checkMovingAverage(const vector<vector<float>> & frames, size_t width, double maxDecibelError) {
+        MovingAverage<float> average;
+        average.initialise(width, frames[0].size());
+        for (size_t f = 0; f < frames.size(); ++f) {
+            average.add(frames[f].data());
+            for (size_t i = 0; i < frames[f].size(); ++i) {
+                double exact = 0;
+                for (size_t w = 0; w < width && w <= f; ++w) {
+                    exact += frames[f - w][i];
+                }
+                float sum = average.getSums()[i];
+                string where = "frame " + std::to_string(f) + ", bin " + std::to_string(i) + ": sum " +
+                    std::to_string(sum) + " instead of " + std::to_string(exact);
+                if (exact == 0) {
+                    check(sum == 0, where);
+                } else {
+                    check(sum > 0 && fabs(10 * log10(sum / exact)) <= maxDecibelError, where);
+                }
+            }
+        }
+    }
+
+    // loud magnitudes followed by digital silence and by much quieter input, like zero-padded final blocks
+    vector<vector<float>> loudThenQuiet(size_t count, size_t bins, bool power) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> uniform(0.5f, 1.5f);
+        vector<vector<float>> frames;
+        for (float level : {1e4f, 0.0f, 1e4f, 1e-3f, 3e5f, 1e-2f}) {
+            for (size_t f = 0; f < count; ++f) {
+                vector<float> frame(bins);
+                for (size_t i = 0; i < bins; ++i) {
+                    // every few bins stay quiet so that loud and quiet bins are mixed in a frame
+                    float magnitude = (i % 7 == 0 ? 1e-3f : level) * uniform(random);
+                    frame[i] = power ? magnitude * magnitude : magnitude;
+                }
+                frames.push_back(frame);
+            }
+        }
+        return frames;
+    }
+
+    void testMovingAverageMagnitudes() {
+        checkMovingAverage(loudThenQuiet(300, 64, false), 8, 1e-4);
+        checkMovingAverage(loudThenQuiet(300, 64, false), 1, 1e-4);
+    }
+
+    // the averaged spectrum in dB like DopplerSpeedCalculator::analyse calculates it in the magnitude or power domain,
+    // for loud spectra followed by silence and by spectra which are 70 and 100 dB quieter
+    void checkAveragingDomain(bool power) {
+        const size_t bins = 129, width = MOVING_FFT_AVERAGE_WIDTH, count = 100;
+        const float factor = power ? 10.0f : 20.0f;
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        MovingAverage<float> average;
+        average.initialise(width, bins);
+        vector<float> spectrum(2 * bins), values(bins), decibels(bins);
+        vector<vector<float>> window;
+        size_t step = 0;
+        for (float level : {1e4f, 0.0f, 1e4f, 3.16f, 1e5f, 1.0f}) {
+            for (size_t f = 0; f < count; ++f, ++step) {
+                for (float & value : spectrum) {
+                    value = level * uniform(random);
+                }
+                if (power) {
+                    VectorKernels::squaredMagnitudes(spectrum.data(), values.data(), bins);
+                } else {
+                    VectorKernels::magnitudes(spectrum.data(), values.data(), bins);
+                }
+                average.add(values.data());
+                window.push_back(values);
+                if (window.size() > width) {
+                    window.erase(window.begin());
+                }
+                VectorKernels::decibels(average.getSums(), decibels.data(), bins, 1.0f / width, factor);
+
+                for (size_t i = 0; i < bins; ++i) {
+                    double exact = 0;
+                    for (auto& frame : window) {
+                        exact += frame[i];
+                    }
+                    string where = string(power ? "power" : "magnitude") + " step " + std::to_string(step) + ", bin " +
+                        std::to_string(i) + ": " + std::to_string(decibels[i]) + " dB";
+                    if (exact == 0) {
+                        check(decibels[i] <= factor * log10f(2.0f) * VectorKernels::fastLog2(0.0f) + 1e-3f, where + " instead of the floor");
+                    } else {
+                        double expected = factor * log10(exact / width);
+                        check(fabs(decibels[i] - expected) < 1e-3, where + " instead of " + std::to_string(expected));
+                    }
+                }
+            }
+        }
+    }
+
+    void testAveragingDomains() {
+        checkAveragingDomain(false);
+        checkAveragingDomain(true);
+    }
+
+    // the stable begin as the forward scan over all peaks of the history found it
+    const Peak<float>* scanStableBegin(const vector<const Peak<float> *> & peaks) {
+        size_t stableLength = 0;
+        double stableValue = 0.0;
+        for (const Peak<float> *peak : peaks) {
+            if (stableValue == peak->position) {
+                stableLength++;
+            } else {
+                stableLength = 0;
+                stableValue = peak->position;
+            }
+            if (stableLength >= STABLE_LENGTH_MINIMUM) {
+                return peak;
+            }
+        }
+        return nullptr;
+    }
+
+    // the stable end as the backward scan over the kept peaks found it
+    const Peak<float>* scanStableEnd(const vector<const Peak<float> *> & peaks, size_t kept) {
+        size_t stableLength = 0;
+        double stableValue = 0.0;
+        for (size_t i = peaks.size(); i > peaks.size() - kept; --i) {
+            const Peak<float> *peak = peaks[i - 1];
+            if (fabs(stableValue - peak->interpolatedPosition) <= 1) {
+                stableLength++;
+            } else {
+                stableLength = 0;
+                stableValue = peak->interpolatedPosition;
+            }
+            if (stableLength > STABLE_LENGTH_MINIMUM) {
+                return peak;
+            }
+        }
+        return nullptr;
+    }
+
+    // the stable begin and end which PeakHistory finds while adding the peaks are compared to the ones of the scans on
+    // random histories: positions near 0 (which the stable end is measured against at first) and further up, with
+    // missed peaks, restarts and lengths around STABLE_END_WINDOW
+    void testStableBeginAndEnd() {
+        const size_t steps = 20000;
+        std::mt19937 random(4);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (size_t maxLength : {(size_t) 0, (size_t) 1, (size_t) STABLE_END_WINDOW - 1, (size_t) STABLE_END_WINDOW,
+                                 (size_t) STABLE_END_WINDOW + 1, (size_t) 16}) {
+            // the peaks must stay where they are while the history points to them
+            vector<Peak<float>> storage(steps);
+            vector<const Peak<float> *> added;
+            PeakHistory<float> history(3, maxLength);
+            double position = 1;
+            for (size_t step = 0; step < steps; ++step) {
+                // mostly small steps, which form streaks of +-1, and a few jumps
+                double r = uniform(random);
+                if (r < 0.1) {
+                    position = uniform(random) < 0.5 ? 3 * uniform(random) : 5 + 20 * uniform(random);
+                } else if (r < 0.6) {
+                    position = std::max(0.0, position + 0.8 * (uniform(random) - 0.5));
+                } else if (r < 0.7) {
+                    position = std::max(0.0, position + (uniform(random) < 0.5 ? -1.5 : 1.5));
+                }
+                // on a grid of quarter bins, so that some positions are exactly 1 apart
+                position = round(4 * position) / 4;
+                storage[step] = Peak<float>(1, 1, (size_t) (position + 0.5), position,
+                                            RealTime::frame2RealTime(step, (unsigned int) TEST_SAMPLE_RATE));
+
+                if (!added.empty() && uniform(random) < 0.005) {
+                    added.clear();
+                    history.restart(&storage[step]);
+                } else {
+                    if (uniform(random) < 0.05) {
+                        history.noPeak();
+                    }
+                    history.addPeak(&storage[step]);
+                }
+                added.push_back(&storage[step]);
+
+                string where = "maximum length " + std::to_string(maxLength) + ", step " + std::to_string(step);
+                size_t kept = maxLength > 0 ? std::min(maxLength, added.size()) : added.size();
+                check(history.getStableEnd() == scanStableEnd(added, kept), where + ": stable end differs");
+
+                const Peak<float> *begin = history.getStableBegin();
+                const Peak<float> *expected = scanStableBegin(added);
+                check((begin == nullptr) == (expected == nullptr), where + ": stable begin found by only one of them");
+                if (begin != nullptr && expected != nullptr) {
+                    check(begin->timestamp == expected->timestamp && begin->interpolatedPosition == expected->interpolatedPosition,
+                          where + ": stable begin differs");
+                }
+            }
+        }
+    }
+
+    // spectra (blockSize + 2 interleaved values) of two steady tones in noise
+    vector<vector<float>> toneSpectra(size_t count, size_t blockSize) {
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        vector<vector<float>> spectra(count, vector<float>(blockSize + 2));
+        for (auto& spectrum : spectra) {
+            for (float & value : spectrum) {
+                value = noise(random);
+            }
+            for (size_t bin : {150, 400}) {
+                spectrum[2 * bin] = 1000;
+            }
+        }
+        return spectra;
+    }
+
+    // in streaming mode, process doesn't allocate once the peak histories are full
+    void testProcessAllocations() {
+        const size_t blockSize = 8192, stepSize = 2048, steps = 4 * STREAMING_HISTORY_LENGTH;
+        vector<vector<float>> spectra = toneSpectra(16, blockSize);
+        DopplerSpeedCalculator calculator(TEST_SAMPLE_RATE);
+        calculator.setParameter(STREAMING_MODE_ID, 1);
+        check(calculator.initialise(1, stepSize, blockSize), "can't initialise the plugin");
+
+        size_t step = 0;
+        auto process = [&]() {
+            const float *input = spectra[step % spectra.size()].data();
+            calculator.process(&input, RealTime::frame2RealTime(step * stepSize, (unsigned int) TEST_SAMPLE_RATE));
+            step++;
+        };
+        for (size_t i = 0; i < STREAMING_HISTORY_LENGTH + 2 * MOVING_FFT_AVERAGE_WIDTH; ++i) {
+            process();
+        }
+        size_t before = allocations;
+        for (size_t i = 0; i < steps; ++i) {
+            process();
+        }
+        size_t count = allocations - before;
+        check(count == 0, std::to_string(count) + " allocations in " + std::to_string(steps) + " steps");
+    }
+
+    // the documented error bounds of the decibels, and the floor for values which have no logarithm
+    void testDecibels() {
+        vector<float> input, output;
+        for (uint32_t bits = 0x00800000; bits < 0x7f800000; bits += 257) {
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            input.push_back(value);
+        }
+        output.resize(input.size());
+        VectorKernels::decibels(input.data(), output.data(), input.size(), 1.0f, 20.0f);
+        for (size_t i = 0; i < input.size(); ++i) {
+            double error = fabs(output[i] - 20 * log10((double) input[i]));
+            double bound = input[i] >= 1e-12f && input[i] <= 1e3f ? 3.6e-5 : 1.1e-4;
+            if (error > bound) {
+                check(false, "error " + std::to_string(error) + " dB at " + std::to_string(input[i]));
+            }
+        }
+
+        float floor = 20 * VectorKernels::fastLog2(0.0f) * log10f(2.0f);
+        vector<float> invalid = {0.0f, -0.0f, 1e-45f, -1e-30f, -1.0f, -3e38f, NAN, -2.0f, -1e5f, 0.0f};
+        output.resize(invalid.size());
+        VectorKernels::decibels(invalid.data(), output.data(), invalid.size(), 1.0f, 20.0f);
+        for (size_t i = 0; i < invalid.size(); ++i) {
+            check(fabs(output[i] - floor) < 1e-3, std::to_string(invalid[i]) + " gives " + std::to_string(output[i]) + " dB");
+            check(VectorKernels::fastLog2(invalid[i]) < -126, "fastLog2 of " + std::to_string(invalid[i]));
+        }
+    }
+
+    // rms of the output of the decimator for a sine of the given frequency (cycles per input sample) over 5000 outputs
+    // after the transient, times sqrt(2)
+    double decimatedAmplitude(size_t stages, double frequency) {
+        const size_t outputs = 5000;
+        HalfBandDecimator decimator;
+        decimator.initialise(stages, 0);
+        size_t factor = decimator.getFactor(), transient = decimator.getDelay() / factor + HALF_BAND_LENGTH;
+        vector<float> signal(factor * (transient + outputs)), output(signal.size());
+        for (size_t n = 0; n < signal.size(); ++n) {
+            signal[n] = (float) sin(2 * M_PI * fmod(frequency * n, 1.0));
+        }
+        decimator.initialise(stages, signal.size());
+        size_t count = decimator.process(signal.data(), signal.size(), output.data());
+        double squares = 0;
+        for (size_t k = count - outputs; k < count; ++k) {
+            squares += (double) output[k] * output[k];
+        }
+        return sqrt(2 * squares / outputs);
+    }
+
+    // the outputs don't depend on how the signal is split into blocks, flush returns the outputs which follow if zeros
+    // are fed, the delay is right, and sines are passed or suppressed with the documented accuracy: up to 0.4 times the
+    // output sample rate and at all frequencies which alias into that band (whole numbers of periods in 5000 outputs)
+    void testHalfBandDecimator() {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        std::uniform_int_distribution<size_t> lengths(1, 700);
+        vector<float> signal(20000);
+        for (float & value : signal) {
+            value = noise(random);
+        }
+
+        for (size_t stages = 1; stages <= MAX_ZOOM; ++stages) {
+            string name = std::to_string(stages) + " stages: ";
+            HalfBandDecimator whole, blocks;
+            whole.initialise(stages, signal.size());
+            blocks.initialise(stages, 700);
+            size_t factor = whole.getFactor(), delay = whole.getDelay();
+            check(delay % factor == 0 && delay >= HALF_BAND_LENGTH / 2 * (factor - 1), name + "delay " + std::to_string(delay));
+
+            vector<float> expected(signal.size()), output(signal.size()), flushed(HALF_BAND_LENGTH / 2);
+            expected.resize(whole.process(signal.data(), signal.size(), expected.data()));
+            size_t written = 0, mismatches = 0;
+            for (size_t start = 0; start < signal.size(); ) {
+                size_t n = std::min(lengths(random), signal.size() - start);
+                written += blocks.process(&signal[start], n, &output[written]);
+                start += n;
+
+                // the last flushed output is centered on the last sample or at most factor - 1 samples before it
+                size_t last = factor * (written + blocks.flush(flushed.data()) - 1) - delay;
+                check(last < start && last + factor >= start, name + "flushed up to " + std::to_string(last) + " of " + std::to_string(start));
+            }
+            for (size_t k = 0; k < std::min(written, expected.size()); ++k) {
+                mismatches += output[k] != expected[k];
+            }
+            check(written == expected.size() && mismatches == 0, name + std::to_string(written) + " outputs in blocks instead of " +
+                  std::to_string(expected.size()) + ", " + std::to_string(mismatches) + " differ");
+
+            vector<float> zeros(delay), continued(zeros.size());
+            size_t flushCount = whole.flush(flushed.data());
+            size_t continuedCount = whole.process(zeros.data(), zeros.size(), continued.data());
+            for (size_t k = 0; k < flushCount; ++k) {
+                check(k < continuedCount && flushed[k] == continued[k], name + "flushed output " + std::to_string(k));
+            }
+
+            // an impulse comes out at the output which is centered on it
+            vector<float> impulse(factor * 200, 0.0f);
+            impulse[factor * 100] = 1;
+            whole.reset();
+            output.resize(whole.process(impulse.data(), impulse.size(), output.data()));
+            size_t peak = std::max_element(output.begin(), output.end()) - output.begin();
+            check(factor * peak - delay == factor * 100, name + "impulse at output " + std::to_string(peak));
+
+            for (size_t j = 1; j <= 20; ++j) {
+                double amplitude = 20 * log10(decimatedAmplitude(stages, 0.02 * j / factor));
+                check(fabs(amplitude) < 0.01, name + std::to_string(amplitude) + " dB at " + std::to_string(0.02 * j) + " of the output rate");
+            }
+            for (size_t alias = 1; alias < factor; ++alias) {
+                for (int j = -20; j <= 20; ++j) {
+                    double frequency = (alias + 0.02 * j) / factor;
+                    if (frequency >= 0.5) continue;
+                    double amplitude = 20 * log10(decimatedAmplitude(stages, frequency));
+                    check(amplitude < -70, name + std::to_string(amplitude) + " dB at " + std::to_string(frequency) + " of the input rate");
+                }
+            }
+        }
+    }
+
+    // a source with three harmonics passing a microphone 5 m away with 60 km/h, in white noise
+    vector<float> passingSource(size_t length) {
+        const double speed = 60 / 3.6, distance = 5, speedOfSound = 343, frequency = 600;
+        std::mt19937 random(4);
+        std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+        vector<float> signal(length);
+        double phase = 0;
+        for (size_t n = 0; n < length; ++n) {
+            double x = speed * (n / TEST_SAMPLE_RATE - length / TEST_SAMPLE_RATE / 2);
+            double r = sqrt(x * x + distance * distance);
+            phase += 2 * M_PI * frequency * speedOfSound / (speedOfSound + speed * x / r) / TEST_SAMPLE_RATE;
+            signal[n] = (float) ((sin(phase) + 0.5 * sin(2 * phase + 1) + 0.25 * sin(3 * phase + 2)) * 5 / r) + noise(random);
+        }
+        return signal;
+    }
+
+    // all features of doppler-speed-calculator-td for the signal with the given zoom
+    DopplerSpeedCalculator::FeatureSet analyseTimeDomain(const vector<float> & signal, float zoom, size_t stepSize) {
+        const size_t blockSize = 8192;
+        TimeDomainDopplerSpeedCalculator calculator(TEST_SAMPLE_RATE);
+        calculator.setParameter(ZOOM_ID, zoom);
+        calculator.setParameter(PEAK_INTERPOLATION_ID, QUADRATIC_LOG_INTERPOLATION);
+        calculator.getOutputDescriptors();
+        DopplerSpeedCalculator::FeatureSet features;
+        if (!calculator.initialise(1, stepSize, blockSize)) {
+            return features;
+        }
+        for (size_t start = 0; start + blockSize <= signal.size(); start += stepSize) {
+            const float *input = &signal[start];
+            auto stepFeatures = calculator.process(&input, RealTime::frame2RealTime(start, (unsigned int) TEST_SAMPLE_RATE));
+            for (auto& output : stepFeatures) {
+                features[output.first].insert(features[output.first].end(), output.second.begin(), output.second.end());
+            }
+        }
+        for (auto& output : calculator.getRemainingFeatures()) {
+            features[output.first].insert(features[output.first].end(), output.second.begin(), output.second.end());
+        }
+        return features;
+    }
+
+    // the decimated spectra have the same bins as the plain ones below the upper threshold frequency, so the same peaks
+    // are found at the same times, for step sizes which are a multiple of the decimation and for others
+    void testZoomMatchesPlain() {
+        vector<float> signal = passingSource((size_t) (4 * TEST_SAMPLE_RATE));
+        for (size_t stepSize : {2048, 1500}) {
+            auto plain = analyseTimeDomain(signal, NO_ZOOM, stepSize);
+            check(plain.size() == 2 && !plain.begin()->second.empty(), "no features without zoom");
+            for (size_t zoom = 1; zoom <= MAX_ZOOM; ++zoom) {
+                string name = "zoom " + std::to_string(zoom) + ", step " + std::to_string(stepSize) + ": ";
+                // the decimated samples are centered on multiples of the decimation, so the window may start up to
+                // decimation - 1 samples earlier if the step size isn't a multiple of it (1 µs for the rounding)
+                size_t decimation = (size_t) 1 << zoom;
+                double tolerance = (stepSize % decimation == 0 ? 0 : decimation - 1) / TEST_SAMPLE_RATE + 1e-6;
+                auto zoomed = analyseTimeDomain(signal, zoom, stepSize);
+                check(zoomed.size() == plain.size(), name + std::to_string(zoomed.size()) + " outputs");
+                for (auto& output : plain) {
+                    auto & features = zoomed[output.first];
+                    check(features.size() == output.second.size(), name + std::to_string(features.size()) + " features of output " +
+                          std::to_string(output.first) + " instead of " + std::to_string(output.second.size()));
+                    for (size_t i = 0; i < std::min(features.size(), output.second.size()); ++i) {
+                        const auto & expected = output.second[i];
+                        const auto & feature = features[i];
+                        double shift = fabs((feature.timestamp - expected.timestamp).sec + (feature.timestamp - expected.timestamp).nsec * 1e-9);
+                        check(shift <= tolerance, name + "feature " + std::to_string(i) + " moved by " + std::to_string(shift) + " s");
+                        check(feature.values.size() == expected.values.size(), name + "values of feature " + std::to_string(i));
+                        for (size_t v = 0; v < std::min(feature.values.size(), expected.values.size()); ++v) {
+                            check(fabs(feature.values[v] - expected.values[v]) < 0.01, name + "value " + std::to_string(v) + " of feature " +
+                                  std::to_string(i) + ": " + std::to_string(feature.values[v]) + " instead of " + std::to_string(expected.values[v]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // every frame pushed to the writer is either written as a line or counted by a comment line in its place, in order;
+    // the frames are pushed much faster than they can be written, so most of them are dropped, and the pauses every
+    // 1000 frames let the writer catch up, so runs of dropped frames are followed by written ones
+    void testAsyncCsvWriter() {
+        const size_t frameSize = 200, frames = 3000;
+        const string path = "wunderwelt-tests.csv";
+        AsyncCsvWriter writer;
+        check(writer.open(path, "header", frameSize), "can't open " + path);
+        vector<float> frame(frameSize);
+        for (size_t i = 0; i < frames; ++i) {
+            std::fill(frame.begin(), frame.end(), (float) i);
+            writer.push(frame.data());
+            if (i % 1000 == 999) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        }
+        size_t dropped = writer.getDroppedFrames();
+        writer.close();
+
+        std::ifstream file(path);
+        string line;
+        check(std::getline(file, line) && line == "header", "header " + line);
+        size_t next = 0, markedDrops = 0;
+        bool marker = false;
+        while (std::getline(file, line)) {
+            size_t count = 0;
+            if (sscanf(line.c_str(), "# %zu frames dropped", &count) == 1) {
+                check(!marker && count > 0, "marker of " + std::to_string(count) + " frames after a marker at frame " + std::to_string(next));
+                next += count;
+                markedDrops += count;
+                marker = true;
+                continue;
+            }
+            check(atof(line.c_str()) == next && std::count(line.begin(), line.end(), ';') == (long) frameSize,
+                  "line of frame " + std::to_string(next) + ": " + line.substr(0, 40));
+            next++;
+            marker = false;
+        }
+        check(next == frames, std::to_string(next) + " frames in the file instead of " + std::to_string(frames));
+        check(markedDrops == dropped, std::to_string(markedDrops) + " dropped frames marked instead of " + std::to_string(dropped));
+        file.close();
+        remove(path.c_str());
+    }
+
+    // the best assignment of at most one peak per history and one history per peak within maxBinJump, tried exhaustively
+    // (crossing ones included): the most matches, then the smallest total distance
+    void assignExhaustively(const vector<double> & histories, const vector<double> & peaks, double maxBinJump, size_t history,
+                            vector<bool> & used, size_t matches, double distance, size_t & bestMatches, double & bestDistance) {
+        if (history == histories.size()) {
+            if (matches > bestMatches || (matches == bestMatches && distance < bestDistance)) {
+                bestMatches = matches;
+                bestDistance = distance;
+            }
+            return;
+        }
+        assignExhaustively(histories, peaks, maxBinJump, history + 1, used, matches, distance, bestMatches, bestDistance);
+        for (size_t p = 0; p < peaks.size(); ++p) {
+            double jump = fabs(peaks[p] - histories[history]);
+            if (!used[p] && jump <= maxBinJump) {
+                used[p] = true;
+                assignExhaustively(histories, peaks, maxBinJump, history + 1, used, matches + 1, distance + jump, bestMatches, bestDistance);
+                used[p] = false;
+            }
+        }
+    }
+
+    // the banded dynamic programming of the assignment mode finds an assignment as good as the best of all possible ones,
+    // for random histories and peaks whose ranges of maxBinJump overlap
+    void testOptimalAssignment() {
+        const double maxBinJump = 3;
+        std::mt19937 random(10);
+        std::uniform_real_distribution<double> uniform(0, 20);
+        std::uniform_int_distribution<size_t> historyCount(1, 5), peakCount(0, 6);
+        for (size_t trial = 0; trial < 500; ++trial) {
+            vector<Peak<float>> initial(historyCount(random)), peaks(peakCount(random));
+            vector<double> historyPositions(initial.size()), peakPositions(peaks.size());
+            for (double & position : historyPositions) {
+                position = uniform(random);
+            }
+            for (double & position : peakPositions) {
+                position = uniform(random);
+            }
+            std::sort(historyPositions.begin(), historyPositions.end());
+            std::sort(peakPositions.begin(), peakPositions.end());
+            for (size_t i = 0; i < initial.size(); ++i) {
+                initial[i] = Peak<float>(1, 1, (size_t) historyPositions[i], historyPositions[i], RealTime(0, 0));
+            }
+            for (size_t i = 0; i < peaks.size(); ++i) {
+                peaks[i] = Peak<float>(1, 1, (size_t) peakPositions[i], peakPositions[i], RealTime(1, 0));
+            }
+
+            PeakTracer<float> tracer;
+            tracer.initialise(maxBinJump, 10, 0, 0, PeakTracer<float>::assignmentMode);
+            tracer.trace(initial.data(), initial.size(), true, false, [](PeakHistory<float> &) {});
+            size_t matches = 0;
+            double distance = 0;
+            vector<bool> used(peaks.size(), false);
+            size_t i = 0;
+            tracer.trace(peaks.data(), peaks.size(), false, false, [&](PeakHistory<float> & history) {
+                if (history.numberOfMissed() == 0) {
+                    double position = history.getLast()->interpolatedPosition;
+                    size_t p = std::find(peakPositions.begin(), peakPositions.end(), position) - peakPositions.begin();
+                    check(p < peaks.size() && !used[p], "trial " + std::to_string(trial) + ": peak " + std::to_string(p) + " assigned twice");
+                    if (p < peaks.size()) {
+                        used[p] = true;
+                    }
+                    matches++;
+                    distance += fabs(position - historyPositions.at(i));
+                }
+                i++;
+            });
+
+            size_t bestMatches = 0;
+            double bestDistance = 0;
+            std::fill(used.begin(), used.end(), false);
+            assignExhaustively(historyPositions, peakPositions, maxBinJump, 0, used, 0, 0, bestMatches, bestDistance);
+            check(i == initial.size(), "trial " + std::to_string(trial) + ": " + std::to_string(i) + " histories visited");
+            check(matches == bestMatches && fabs(distance - bestDistance) < 1e-9, "trial " + std::to_string(trial) + ": " +
+                  std::to_string(matches) + " matches with distance " + std::to_string(distance) + " instead of " +
+                  std::to_string(bestMatches) + " with " + std::to_string(bestDistance));
+        }
+    }
+
+    // a spurious peak between two histories, within reach of both, doesn't take the place of the peak which continues
+    // either of them, wherever it lies between them; both histories keep following their own line
+    void testPeakBetweenHistories() {
+        const double maxBinJump = 4;
+        PeakTracer<float> tracer;
+        tracer.initialise(maxBinJump, 3, 0, 0, PeakTracer<float>::assignmentMode);
+        const double lower = 10, upper = 17;
+        for (int step = 0; step < 12; ++step) {
+            // the histories move towards each other by 0.2 bins per step, the spurious peak lies at varying points between them
+            double lowerPosition = lower + 0.2 * step, upperPosition = upper - 0.2 * step;
+            double between = lowerPosition + (upperPosition - lowerPosition) * (0.3 + 0.1 * (step % 5));
+            vector<Peak<float>> peaks;
+            peaks.push_back(Peak<float>(1, 1, (size_t) lowerPosition, lowerPosition, RealTime(step, 0)));
+            if (step > 0) {
+                peaks.push_back(Peak<float>(1, 1, (size_t) between, between, RealTime(step, 0)));
+            }
+            peaks.push_back(Peak<float>(1, 1, (size_t) upperPosition, upperPosition, RealTime(step, 0)));
+            tracer.trace(peaks.data(), peaks.size(), true, false, [](PeakHistory<float> &) {});
+            check(tracer.size() == 2, "step " + std::to_string(step) + ": " + std::to_string(tracer.size()) + " histories");
+        }
+        for (size_t h = 0; h < std::min<size_t>(tracer.size(), 2); ++h) {
+            vector<std::pair<RealTime, double>> positions;
+            tracer[h].getInterpolatedPositionHistory(positions);
+            check(positions.size() == 12 && tracer[h].numberOfMissed() == 0, "history " + std::to_string(h) + " has " +
+                  std::to_string(positions.size()) + " peaks");
+            for (size_t step = 0; step < positions.size(); ++step) {
+                double expected = h == 0 ? lower + 0.2 * step : upper - 0.2 * step;
+                check(fabs(positions[step].second - expected) < 1e-9, "history " + std::to_string(h) + ", step " + std::to_string(step) +
+                      ": " + std::to_string(positions[step].second) + " instead of " + std::to_string(expected));
+            }
+        }
+    }
+
+    // the 5 point quadratic (and cubic) smoothing has the textbook coefficients (-3, 12, 17, 12, -3) / 35
+    void testSavitzkyGolayCoefficients() {
+        const float expected[] = {-3.0f / 35, 12.0f / 35, 17.0f / 35, 12.0f / 35, -3.0f / 35};
+        for (size_t order : {2, 3}) {
+            SavitzkyGolay filter;
+            filter.initialise(2, order);
+            check(filter.getWindowLength() == 5 && filter.getOrder() == order, "order " + std::to_string(order) + ": window");
+            const float *coefficients = filter.getCoefficients(0);
+            for (size_t k = 0; k < 5; ++k) {
+                check(fabs(coefficients[k] - expected[k]) < 1e-6, "order " + std::to_string(order) + ": coefficient " + std::to_string(k) +
+                      " is " + std::to_string(coefficients[k] * 35) + " / 35");
+            }
+        }
+    }
+
+    // a polynomial of the order of the fit is its own least squares fit, so it passes unchanged, in the inner values as
+    // well as in the first and last halfWidth values which are evaluated from the first and last window
+    void testSavitzkyGolayPolynomials() {
+        const size_t n = 101;
+        std::mt19937 random(11);
+        std::uniform_real_distribution<double> uniform(-1, 1);
+        // the order of the last one is reduced to 2 * halfWidth
+        const size_t settings[][2] = {{1, 1}, {2, 2}, {3, 3}, {5, 4}, {4, 1}, {6, 5}, {2, 6}};
+        for (auto & setting : settings) {
+            SavitzkyGolay filter;
+            filter.initialise(setting[0], setting[1]);
+            size_t order = filter.getOrder();
+            vector<double> polynomial(order + 1);
+            for (double & coefficient : polynomial) {
+                coefficient = uniform(random);
+            }
+            vector<float> input(n), output(n, -1);
+            for (size_t i = 0; i < n; ++i) {
+                double x = ((double) i - n / 2) / (n / 2), value = 0;
+                for (size_t p = order + 1; p-- > 0; ) {
+                    value = value * x + polynomial[p];
+                }
+                input[i] = (float) value;
+            }
+            filter.apply(input.data(), output.data(), n);
+            string name = "half width " + std::to_string(setting[0]) + ", order " + std::to_string(order) + ": ";
+            for (size_t i = 0; i < n; ++i) {
+                check(fabs(output[i] - input[i]) < 1e-5, name + "value " + std::to_string(i) + " is " + std::to_string(output[i]) +
+                      " instead of " + std::to_string(input[i]));
+            }
+        }
+    }
+
+    // the number of the output with the given identifier, -1 if there is none
+    int outputNumber(const Vamp::Plugin::OutputList & outputs, const string & identifier) {
+        for (size_t o = 0; o < outputs.size(); ++o) {
+            if (outputs[o].identifier == identifier) {
+                return (int) o;
+            }
+        }
+        return -1;
+    }
+
+    bool closeTo(double value, double expected) {
+        return fabs(value - expected) <= 1e-5 * fabs(expected);
+    }
+
+    // the peak and sum of squares of the vectorized kernel equal the ones of a plain loop for lengths which leave
+    // remainders after the vectorized part
+    void testPeakAndSumOfSquares() {
+        std::mt19937 random(8);
+        std::uniform_real_distribution<float> uniform(-2.0f, 1.0f);
+        for (size_t n : {0, 1, 3, 7, 8, 9, 15, 17, 31, 33, 1023, 4097}) {
+            vector<float> values(n);
+            for (float & value : values) {
+                value = uniform(random);
+            }
+            float expectedPeak = 0;
+            double expectedSum = 0;
+            for (float value : values) {
+                expectedPeak = std::max(expectedPeak, fabsf(value));
+                expectedSum += (double) value * value;
+            }
+            float peak = -1, sum = -1;
+            VectorKernels::peakAndSumOfSquares(values.data(), n, peak, sum);
+            string name = "length " + std::to_string(n) + ": ";
+            check(peak == expectedPeak, name + "peak " + std::to_string(peak) + " instead of " + std::to_string(expectedPeak));
+            check(closeTo(sum, expectedSum), name + "sum of squares " + std::to_string(sum) + " instead of " + std::to_string(expectedSum));
+        }
+    }
+
+    // peak, RMS and crest factor of amplitude-follower over all channels and per channel equal the ones calculated
+    // sample by sample, for odd numbers of channels and odd block sizes, with a silent channel whose crest factor is 0
+    void testAmplitudeStatistics() {
+        std::mt19937 random(9);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        for (size_t channels : {1, 3}) {
+            for (size_t blockSize : {1023, 513, 1}) {
+                AmplitudeFollower plugin(TEST_SAMPLE_RATE);
+                string name = std::to_string(channels) + " channels, block " + std::to_string(blockSize) + ": ";
+                check(plugin.initialise(channels, blockSize, blockSize), name + "not initialised");
+                auto outputs = plugin.getOutputDescriptors();
+                int amplitude = outputNumber(outputs, "curve-fsr-amplitude"), rms = outputNumber(outputs, "curve-rms"),
+                    crestFactor = outputNumber(outputs, "curve-crest-factor"),
+                    channelAmplitude = outputNumber(outputs, "channel-amplitude"), channelRms = outputNumber(outputs, "channel-rms"),
+                    channelCrestFactor = outputNumber(outputs, "channel-crest-factor");
+
+                for (size_t block = 0; block < 3; ++block) {
+                    vector<vector<float>> signals(channels, vector<float>(blockSize));
+                    vector<const float *> input;
+                    for (size_t c = 0; c < channels; ++c) {
+                        float level = c == 1 ? 0.0f : 0.2f * (c + block + 1);
+                        for (float & value : signals[c]) {
+                            value = level * uniform(random);
+                        }
+                        input.push_back(signals[c].data());
+                    }
+                    auto features = plugin.process(input.data(), RealTime::frame2RealTime(block * blockSize, (unsigned int) TEST_SAMPLE_RATE));
+                    string where = name + "block " + std::to_string(block) + ": ";
+                    bool complete = features[amplitude].size() == 1 && features[rms].size() == 1 && features[crestFactor].size() == 1 &&
+                        features[channelAmplitude].size() == 1 && features[channelRms].size() == 1 && features[channelCrestFactor].size() == 1;
+                    check(complete, where + "missing features");
+                    if (!complete) continue;
+
+                    float expectedPeak = 0;
+                    double expectedSum = 0;
+                    for (size_t c = 0; c < channels; ++c) {
+                        float channelPeak = 0;
+                        double channelSum = 0;
+                        for (float value : signals[c]) {
+                            channelPeak = std::max(channelPeak, fabsf(value));
+                            channelSum += (double) value * value;
+                        }
+                        double expectedRms = sqrt(channelSum / blockSize);
+                        double expectedCrestFactor = channelSum > 0 ? channelPeak / expectedRms : 0;
+                        string channel = where + "channel " + std::to_string(c) + ": ";
+                        check(features[channelAmplitude][0].values.at(c) == channelPeak, channel + "peak");
+                        check(closeTo(features[channelRms][0].values.at(c), expectedRms), channel + "rms " +
+                              std::to_string(features[channelRms][0].values[c]) + " instead of " + std::to_string(expectedRms));
+                        check(closeTo(features[channelCrestFactor][0].values.at(c), expectedCrestFactor), channel + "crest factor " +
+                              std::to_string(features[channelCrestFactor][0].values[c]) + " instead of " + std::to_string(expectedCrestFactor));
+                        expectedPeak = std::max(expectedPeak, channelPeak);
+                        expectedSum += channelSum;
+                    }
+                    double expectedRms = sqrt(expectedSum / (channels * blockSize));
+                    check(features[amplitude][0].values.at(0) == expectedPeak, where + "peak");
+                    check(closeTo(features[rms][0].values.at(0), expectedRms), where + "rms " +
+                          std::to_string(features[rms][0].values[0]) + " instead of " + std::to_string(expectedRms));
+                    check(closeTo(features[crestFactor][0].values.at(0), expectedPeak / expectedRms), where + "crest factor");
+                }
+            }
+        }
+    }
+
+    // noise bursts of different levels which decay exponentially, separated by digital silence
+    vector<float> bursts(size_t length, unsigned int seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        vector<float> signal(length);
+        float level = 0;
+        for (size_t n = 0; n < length; ++n) {
+            if (n % 5000 == 0) {
+                level = n % 15000 == 10000 ? 0.0f : 0.01f + fabs(noise(random));
+            }
+            level *= 0.9995f;
+            signal[n] = level * noise(random);
+        }
+        return signal;
+    }
+
+    // the envelope at the end of each hop, following the signal sample by sample
+    vector<float> followEnvelope(const vector<float> & signal, float attackTime, float releaseTime, size_t hopSize) {
+        float attack = exp(-1.0f / attackTime), release = exp(-1.0f / releaseTime);
+        vector<float> envelopes;
+        float envelope = 0;
+        for (size_t n = 0; n < signal.size(); ++n) {
+            float value = fabs(signal[n]);
+            float coefficient = value > envelope ? attack : release;
+            envelope = coefficient * envelope + (1.0f - coefficient) * value;
+            if ((n + 1) % hopSize == 0) {
+                envelopes.push_back(envelope);
+            }
+        }
+        return envelopes;
+    }
+
+    // envelopes agree within 1e-4 relative to their value, the ones below 1e-9 (after a long release) count as equal
+    bool sameEnvelope(float envelope, float expected) {
+        return fabs(envelope - expected) <= 1e-4 * fmax(fabs(expected), 1e-5);
+    }
+
+    // the envelope of the chunked follower equals the one followed sample by sample, for hops which are a multiple of
+    // the chunk length and others, and for blocks of different lengths which don't line up with the hops, so the state
+    // is carried across the calls in the middle of hops and chunks
+    void testEnvelopeFollower() {
+        vector<float> signal = bursts(60000, 5);
+        const size_t blocks[] = {1000, 1, 7, 4096, 300, 16, 2500};
+        for (size_t hopSize : {48, 100, 441}) {
+            vector<float> expected = followEnvelope(signal, 50, 2000, hopSize);
+            EnvelopeFollower follower;
+            follower.initialise(50, 2000, hopSize);
+            vector<float> envelopes, output(4096 / hopSize + 1);
+            size_t start = 0;
+            for (size_t b = 0; start < signal.size(); ++b) {
+                size_t n = std::min(blocks[b % 7], signal.size() - start);
+                size_t count = follower.process(&signal[start], n, output.data());
+                envelopes.insert(envelopes.end(), output.begin(), output.begin() + count);
+                start += n;
+            }
+            string name = "hop " + std::to_string(hopSize) + ": ";
+            check(envelopes.size() == expected.size(), name + std::to_string(envelopes.size()) + " values instead of " + std::to_string(expected.size()));
+            for (size_t i = 0; i < std::min(envelopes.size(), expected.size()); ++i) {
+                check(sameEnvelope(envelopes[i], expected[i]), name + "value " + std::to_string(i) + ": " + std::to_string(envelopes[i]) +
+                      " instead of " + std::to_string(expected[i]));
+            }
+        }
+    }
+
+    // the envelopes of amplitude-follower follow the new samples of each block once, for steps smaller than the block;
+    // steps larger than the block would leave gaps, so they aren't accepted
+    void testAmplitudeFollowerEnvelope() {
+        const size_t channels = 2, blockSize = 1024, stepSize = 512;
+        const float attack = 2, release = 50, samplesPerMs = TEST_SAMPLE_RATE / 1000;
+        vector<vector<float>> signals = {bursts(40000, 6), bursts(40000, 7)};
+
+        AmplitudeFollower plugin(TEST_SAMPLE_RATE);
+        plugin.setParameter(ENVELOPE_FOLLOWER_ID, 1);
+        plugin.setParameter(ATTACK_TIME_ID, attack);
+        plugin.setParameter(RELEASE_TIME_ID, release);
+        check(!plugin.initialise(channels, blockSize + 1, blockSize), "step size larger than the block size accepted");
+        check(plugin.initialise(channels, stepSize, blockSize), "step size smaller than the block size not accepted");
+
+        auto outputs = plugin.getOutputDescriptors();
+        int envelopeOutput = outputNumber(outputs, "envelope"), channelEnvelopeOutput = outputNumber(outputs, "channel-envelope");
+        check(envelopeOutput >= 0 && channelEnvelopeOutput >= 0, "no envelope outputs");
+        if (envelopeOutput < 0 || channelEnvelopeOutput < 0) return;
+        size_t hopSize = lrintf(TEST_SAMPLE_RATE / outputs[envelopeOutput].sampleRate);
+
+        AmplitudeFollower::FeatureList envelopes, channelEnvelopes;
+        size_t start = 0;
+        for (; start + blockSize <= signals[0].size(); start += stepSize) {
+            const float *input[] = {&signals[0][start], &signals[1][start]};
+            auto features = plugin.process(input, RealTime::frame2RealTime(start, (unsigned int) TEST_SAMPLE_RATE));
+            auto & e = features[envelopeOutput];
+            auto & ce = features[channelEnvelopeOutput];
+            envelopes.insert(envelopes.end(), e.begin(), e.end());
+            channelEnvelopes.insert(channelEnvelopes.end(), ce.begin(), ce.end());
+        }
+
+        // the blocks cover the signal up to start + blockSize, but only its first start samples were new
+        vector<vector<float>> expected;
+        for (auto & signal : signals) {
+            vector<float> followed(signal.begin(), signal.begin() + start);
+            expected.push_back(followEnvelope(followed, attack * samplesPerMs, release * samplesPerMs, hopSize));
+        }
+        check(envelopes.size() == expected[0].size() && channelEnvelopes.size() == expected[0].size(),
+              std::to_string(envelopes.size()) + " envelopes instead of " + std::to_string(expected[0].size()));
+        for (size_t i = 0; i < std::min(std::min(envelopes.size(), channelEnvelopes.size()), expected[0].size()); ++i) {
+            string name = "envelope " + std::to_string(i) + ": ";
+            RealTime expectedTime = RealTime::frame2RealTime((i + 1) * hopSize, (unsigned int) TEST_SAMPLE_RATE);
+            RealTime shift = envelopes[i].timestamp - expectedTime;
+            check(fabs(shift.sec + shift.nsec * 1e-9) <= 1e-6, name + "timestamp " + envelopes[i].timestamp.toString());
+            check(channelEnvelopes[i].timestamp == envelopes[i].timestamp, name + "timestamps of the channels");
+            check(channelEnvelopes[i].values.size() == channels && envelopes[i].values.size() == 1, name + "value counts");
+            if (channelEnvelopes[i].values.size() != channels || envelopes[i].values.size() != 1) continue;
+            for (size_t c = 0; c < channels; ++c) {
+                check(sameEnvelope(channelEnvelopes[i].values[c], expected[c][i]), name + "channel " + std::to_string(c) + ": " +
+                      std::to_string(channelEnvelopes[i].values[c]) + " instead of " + std::to_string(expected[c][i]));
+            }
+            check(envelopes[i].values[0] == std::max(channelEnvelopes[i].values[0], channelEnvelopes[i].values[1]),
+                  name + "not the maximum of the channels");
+        }
+    }
+
+    // the frames, peaks and parameters written to a spectrum dump are read back unchanged from the mapped file, frames
+    // with different numbers of peaks (none too) included; a dump which isn't closed yet or can't be written is rejected
+    void testSpectrumDump() {
+        const string path = "wunderwelt-tests.dump";
+        const size_t frameSize = 37, frames = 50, channels = 2;
+        SpectrumDumpHeader header = SpectrumDumpHeader();
+        header.sampleRate = TEST_SAMPLE_RATE;
+        header.blockSize = 4096;
+        header.stepSize = 1024;
+        header.fftSize = 4096;
+        header.paddingFactor = 2;
+        header.frameSize = frameSize;
+        header.spectraPerStep = channels;
+        std::map<string, float> parameters = {{"max-bin-jump", 5}, {"peak-tracing-height-threshold", 6.5f}};
+
+        std::mt19937 random(12);
+        std::uniform_real_distribution<float> uniform(-100, 0);
+        vector<vector<float>> spectra(frames, vector<float>(frameSize));
+        vector<vector<Peak<float>>> peaks(frames);
+        SpectrumDumpWriter writer;
+        check(writer.open(path, header, parameters), "can't open " + path);
+        for (size_t f = 0; f < frames; ++f) {
+            for (float & value : spectra[f]) {
+                value = uniform(random);
+            }
+            for (size_t p = 0; p < f % 7; ++p) {
+                size_t position = 5 * p + f % 5;
+                peaks[f].push_back(Peak<float>(spectra[f][position], -uniform(random), position, position + 0.25 * p, RealTime()));
+            }
+            writer.addFrame(f % channels, RealTime::frame2RealTime(f / channels * header.stepSize, (unsigned int) TEST_SAMPLE_RATE),
+                            spectra[f].data(), peaks[f].data(), peaks[f].size());
+        }
+        SpectrumDumpReader reader;
+        check(!reader.open(path), "incomplete dump accepted");
+        writer.close();
+
+        check(reader.open(path), "can't read " + path);
+        if (reader.isOpen()) {
+            const SpectrumDumpHeader & read = reader.getHeader();
+            check(read.sampleRate == header.sampleRate && read.blockSize == header.blockSize && read.stepSize == header.stepSize &&
+                  read.fftSize == header.fftSize && read.paddingFactor == header.paddingFactor && read.frameSize == frameSize &&
+                  read.spectraPerStep == channels, "header");
+            check(reader.getParameters() == parameters, "parameters");
+            check(reader.getFrameCount() == frames, std::to_string(reader.getFrameCount()) + " frames");
+            for (size_t f = 0; f < std::min<size_t>(reader.getFrameCount(), frames); ++f) {
+                string name = "frame " + std::to_string(f) + ": ";
+                check(reader.getFrame(f).channel == f % channels, name + "channel");
+                check(reader.getTimestamp(f) == RealTime::frame2RealTime(f / channels * header.stepSize, (unsigned int) TEST_SAMPLE_RATE),
+                      name + "timestamp " + reader.getTimestamp(f).toString());
+                check(std::equal(spectra[f].begin(), spectra[f].end(), reader.getSpectrum(f)), name + "spectrum");
+                size_t count = 0;
+                const SpectrumDumpPeak *readPeaks = reader.getPeaks(f, count);
+                check(count == peaks[f].size(), name + std::to_string(count) + " peaks");
+                for (size_t p = 0; p < std::min(count, peaks[f].size()); ++p) {
+                    check(readPeaks[p].interpolatedPosition == peaks[f][p].interpolatedPosition && readPeaks[p].position == peaks[f][p].position &&
+                          readPeaks[p].value == peaks[f][p].value && readPeaks[p].height == peaks[f][p].height, name + "peak " + std::to_string(p));
+                }
+            }
+            reader.close();
+        }
+        remove(path.c_str());
+
+        // only where the device exists, every write to it fails once the buffer of the file is flushed
+        if (writer.open("/dev/full", header, parameters)) {
+            for (size_t f = 0; f < 1000 && writer.isOpen(); ++f) {
+                writer.addFrame(0, RealTime(), spectra[0].data(), peaks[0].data(), peaks[0].size());
+            }
+            check(!writer.isOpen(), "failing writes not noticed");
+        }
+    }
+
+    vector<Test> tests() {
+        return {
+            {"moving-average-magnitudes", testMovingAverageMagnitudes},
+            {"decibels", testDecibels},
+            {"averaging-domains", testAveragingDomains},
+            {"stable-begin-and-end", testStableBeginAndEnd},
+            {"process-allocations", testProcessAllocations},
+            {"half-band-decimator", testHalfBandDecimator},
+            {"zoom-matches-plain", testZoomMatchesPlain},
+            {"async-csv-writer", testAsyncCsvWriter},
+            {"spectrum-dump", testSpectrumDump},
+            {"savitzky-golay-coefficients", testSavitzkyGolayCoefficients},
+            {"savitzky-golay-polynomials", testSavitzkyGolayPolynomials},
+            {"optimal-assignment", testOptimalAssignment},
+            {"peak-between-histories", testPeakBetweenHistories},
+            {"peak-and-sum-of-squares", testPeakAndSumOfSquares},
+            {"amplitude-statistics", testAmplitudeStatistics},
+            {"envelope-follower", testEnvelopeFollower},
+            {"amplitude-follower-envelope", testAmplitudeFollowerEnvelope},
+        };
+    }
+}
+
+int main(int argc, char **argv) {
+    string filter = argc > 1 ? argv[1] : "";
+    if (argc > 2) {
+        std::cerr << "usage: wunderwelt-tests [filter]\n"
+                     "  only the tests whose name contains filter are run\n";
+        return 1;
+    }
+
+    // the warnings of the plugins are expected in some tests
+    std::streambuf *errors = std::cerr.rdbuf(nullptr);
+
+    size_t failed = 0;
+    for (auto& test : tests()) {
+        if (test.name.find(filter) == string::npos) {
+            continue;
+        }
+        failures = 0;
+        test.run();
+        std::cout << test.name << ": " << (failures == 0 ? "ok" : "FAILED (" + std::to_string(failures) + " checks)") << std::endl;
+        failed += failures > 0;
+    }
+
+    std::cerr.rdbuf(errors);
+    return failed > 0 ? 1 : 0;
+}
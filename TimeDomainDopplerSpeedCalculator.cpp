@@ -0,0 +1,225 @@
+//
+//  TimeDomainDopplerSpeedCalculator.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "TimeDomainDopplerSpeedCalculator.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <cmath>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+TimeDomainDopplerSpeedCalculator::TimeDomainDopplerSpeedCalculator(float inputSampleRate) :
+    DopplerSpeedCalculator(inputSampleRate),
+    m_channels(0),
+    m_decimation(1),
+    m_windowSize(0),
+    m_transformSize(0),
+    m_spectrumSize(0),
+    m_centerOffset(RealTime::zeroTime),
+    m_newSamples(0),
+    m_gapBetweenBlocks(false),
+    m_decimatorInput(0),
+    m_decimatorOutput(0),
+    m_flushed(0)
+{
+    // the base class only knows its own parameters when it sets the default values
+    this->setParameter(ZERO_PADDING_ID, ZERO_PADDING);
+    this->setParameter(ZOOM_ID, ZOOM);
+}
+
+TimeDomainDopplerSpeedCalculator::~TimeDomainDopplerSpeedCalculator() {
+}
+
+string TimeDomainDopplerSpeedCalculator::getIdentifier() const {
+    return "doppler-speed-calculator-td";
+}
+
+string TimeDomainDopplerSpeedCalculator::getName() const {
+    return "Wunderwelt Doppler-Effect Speed Calculator (Time Domain)";
+}
+
+string TimeDomainDopplerSpeedCalculator::getDescription() const {
+    return "Plugin for deriving the speed of a moving source which emits a stable noise relative to a fixed measuring point. "
+           "Calculates the spectra itself, optionally with zero-padding.";
+}
+
+TimeDomainDopplerSpeedCalculator::InputDomain TimeDomainDopplerSpeedCalculator::getInputDomain() const {
+    return InputDomain::TimeDomain;
+}
+
+TimeDomainDopplerSpeedCalculator::ParameterList TimeDomainDopplerSpeedCalculator::getParameterDescriptors() const {
+    ParameterList plist = DopplerSpeedCalculator::getParameterDescriptors();
+
+    ParameterDescriptor desc = ParameterDescriptor();
+    desc.identifier = ZERO_PADDING_ID;
+    desc.name = "Zero-Padding";
+    desc.description = "Factor by which the windowed blocks are lengthened with zeros before the fft, which interpolates the spectrum";
+    desc.defaultValue = ZERO_PADDING;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = MAX_ZERO_PADDING;
+    desc.valueNames = std::vector<std::string>{"none", "2x", "4x", "8x"};
+    plist.push_back(desc);
+
+    desc = ParameterDescriptor();
+    desc.identifier = ZOOM_ID;
+    desc.name = "Zoom";
+    desc.description = "Factor by which the signal is decimated before the fft, which makes it cheaper without changing the "
+                       "bins, the upper threshold frequency must be below 0.4 times the sample rate divided by the factor";
+    desc.defaultValue = ZOOM;
+    desc.quantizeStep = 1.0f;
+    desc.isQuantized = true;
+    desc.minValue = 0;
+    desc.maxValue = MAX_ZOOM;
+    desc.valueNames = std::vector<std::string>{"off", "2x", "4x", "8x"};
+    plist.push_back(desc);
+
+    return plist;
+}
+
+bool TimeDomainDopplerSpeedCalculator::initialise(size_t channels, size_t stepSize, size_t blockSize) {
+    size_t padding = std::min<size_t>(std::max<float>(getParameter(ZERO_PADDING_ID), 0), MAX_ZERO_PADDING);
+    size_t zoom = std::min<size_t>(std::max<float>(getParameter(ZOOM_ID), 0), MAX_ZOOM);
+    m_decimation = (size_t) 1 << zoom;
+
+    // the real fft needs an even number of values
+    if (blockSize < 2 * m_decimation || blockSize % (2 * m_decimation) != 0) return false;
+
+    m_channels = channels;
+    m_windowSize = blockSize / m_decimation;
+    m_transformSize = m_windowSize << padding;
+    m_centerOffset = RealTime::frame2RealTime(blockSize / 2, (unsigned int) (m_inputSampleRate + 0.5));
+
+    // the decimated block has m_decimation times fewer samples, so its spectrum is that much lower
+    m_window.resize(m_windowSize);
+    for (size_t i = 0; i < m_windowSize; ++i) {
+        m_window[i] = m_decimation * (0.5 - 0.5 * cos(2 * M_PI * i / m_windowSize));
+    }
+
+    // the spectrum of the decimated block has the same bins as the one of the whole block up to the decimated nyquist
+    // frequency, but only the ones below ZOOM_PASSBAND times it pass the lowpass unchanged and are free of aliases
+    m_newSamples = std::min(stepSize, blockSize);
+    m_gapBetweenBlocks = stepSize > blockSize;
+    if (m_decimation > 1) {
+        m_decimators.resize(channels);
+        for (auto& decimator : m_decimators) {
+            decimator.initialise(zoom, blockSize);
+        }
+        m_decimated.assign(channels * m_windowSize, 0);
+        m_decimatorOutputs.assign(std::max<size_t>(m_windowSize + 1, HALF_BAND_LENGTH / 2), 0);
+        m_spectrumSize = (size_t) (ZOOM_PASSBAND * m_transformSize / 2) + 1;
+    } else {
+        m_decimators.clear();
+        m_decimated.clear();
+        m_decimatorOutputs.clear();
+        m_spectrumSize = m_transformSize / 2 + 1;
+    }
+    restartDecimation();
+
+    m_fft.reset(new Vamp::FFTReal((unsigned int) m_transformSize));
+
+    // the values after the window are never written, so they stay zero
+    m_fftInput.assign(m_transformSize, 0);
+    m_fftOutput.assign(m_transformSize + 2, 0);
+    m_spectra.assign(channels * (m_transformSize + 2), 0);
+    m_spectrumPointers.resize(channels);
+    for (size_t c = 0; c < channels; ++c) {
+        m_spectrumPointers[c] = &m_spectra[c * (m_transformSize + 2)];
+    }
+
+    return initialiseAnalysis(channels, stepSize, blockSize, blockSize << padding, m_spectrumSize);
+}
+
+void TimeDomainDopplerSpeedCalculator::reset() {
+    restartDecimation();
+    DopplerSpeedCalculator::reset();
+}
+
+void TimeDomainDopplerSpeedCalculator::restartDecimation() {
+    for (auto& decimator : m_decimators) {
+        decimator.reset();
+    }
+    std::fill(m_decimated.begin(), m_decimated.end(), 0.0f);
+    m_decimatorInput = 0;
+    m_decimatorOutput = 0;
+    m_flushed = 0;
+}
+
+size_t TimeDomainDopplerSpeedCalculator::decimate(size_t channel, const float *input, size_t samples) {
+    size_t count = m_decimators[channel].process(input, samples, m_decimatorOutputs.data());
+
+    // the decimated samples are shifted in at the end, the oldest ones drop out
+    float *decimated = &m_decimated[channel * m_windowSize];
+    if (count >= m_windowSize) {
+        std::copy(m_decimatorOutputs.begin() + (count - m_windowSize), m_decimatorOutputs.begin() + count, decimated);
+    } else {
+        std::copy(decimated + count, decimated + m_windowSize, decimated);
+        std::copy(m_decimatorOutputs.begin(), m_decimatorOutputs.begin() + count, decimated + m_windowSize - count);
+    }
+
+    // the decimated samples at the end of the block whose lowpass reaches beyond it are taken from a zero-padded
+    // copy of the decimator, like the samples after the block would be taken as zero when decimating the block alone
+    size_t flushed = std::min(m_decimators[channel].flush(m_decimatorOutputs.data()), m_windowSize);
+    size_t kept = m_windowSize - flushed;
+    for (size_t i = 0; i < kept; ++i) {
+        m_fftInput[i] = decimated[flushed + i] * m_window[i];
+    }
+    for (size_t i = kept; i < m_windowSize; ++i) {
+        m_fftInput[i] = m_decimatorOutputs[i - kept] * m_window[i];
+    }
+    m_flushed = flushed;
+    return count;
+}
+
+TimeDomainDopplerSpeedCalculator::FeatureSet TimeDomainDopplerSpeedCalculator::process(const float *const *inputBuffers,
+                                                                                         RealTime timestamp) {
+    size_t blockSize = m_windowSize * m_decimation;
+    size_t samples = 0;
+    size_t count = 0;
+    if (m_decimation > 1) {
+        if (m_gapBetweenBlocks) {
+            restartDecimation();
+        }
+        // the first block is decimated as a whole, of the following ones only the samples at their end which are new
+        samples = m_decimatorInput == 0 ? blockSize : m_newSamples;
+    }
+
+    // only the analysed values of the spectrum are converted
+    size_t values = 2 * getAnalysedValues();
+    for (size_t c = 0; c < m_channels; ++c) {
+        if (m_decimation > 1) {
+            count = decimate(c, inputBuffers[c] + blockSize - samples, samples);
+        } else {
+            for (size_t i = 0; i < m_windowSize; ++i) {
+                m_fftInput[i] = inputBuffers[c][i] * m_window[i];
+            }
+        }
+
+        m_fft->forward(m_fftInput.data(), m_fftOutput.data());
+
+        float *spectrum = &m_spectra[c * (m_transformSize + 2)];
+        for (size_t i = 0; i < values; ++i) {
+            spectrum[i] = (float) m_fftOutput[i];
+        }
+    }
+
+    RealTime centerOffset = m_centerOffset;
+    if (m_decimation > 1) {
+        m_decimatorInput += samples;
+        m_decimatorOutput += count;
+
+        // the center of the window over the decimated samples (see HalfBandDecimator::getDelay) relative to the start
+        // of the block, which is at the middle of the block if the step size is a multiple of the decimation
+        long center = (long) (m_decimation * (m_decimatorOutput + m_flushed)) - (long) m_decimators[0].getDelay() -
+                      (long) (m_decimation * m_windowSize / 2) - (long) (m_decimatorInput - blockSize);
+        centerOffset = RealTime::frame2RealTime(center, (unsigned int) (m_inputSampleRate + 0.5));
+    }
+
+    return DopplerSpeedCalculator::process(m_spectrumPointers.data(), timestamp + centerOffset);
+}
@@ -0,0 +1,116 @@
+//
+//  TimeDomainDopplerSpeedCalculator.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef TimeDomainDopplerSpeedCalculator_hpp
+#define TimeDomainDopplerSpeedCalculator_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <vector>
+#include <vamp-sdk/FFT.h>
+
+#include "DopplerSpeedCalculator.hpp"
+#include "HalfBandDecimator.hpp"
+
+// Parameter Identifiers
+#define ZERO_PADDING_ID "zero-padding"
+#define ZOOM_ID "zoom"
+
+// Parameter Default Values
+#define ZERO_PADDING NO_ZERO_PADDING
+#define ZOOM NO_ZOOM
+
+// Values of the zero-padding parameter, the fft size is the block size times 2 to the power of the value
+#define NO_ZERO_PADDING 0
+#define MAX_ZERO_PADDING 3
+
+// Values of the zoom parameter, the block is decimated by 2 to the power of the value before the fft
+#define NO_ZOOM 0
+#define MAX_ZOOM 3
+
+// Other constants
+#define ZOOM_PASSBAND 0.8 // part of the band up to the decimated nyquist frequency which is analysed (see HalfBandDecimator)
+
+// The speed calculator for hosts which feed the plugin with samples instead of spectra. Each block is windowed with
+// a hann window, zero-padded to a multiple of its length and transformed by an fft whose plan is created in initialise,
+// so the step size (i.e. the overlap of the blocks) may be anything the host chooses.
+// In zoom mode, the signal is lowpass filtered and decimated first. Only the samples which are new since the last block
+// are decimated (by a HalfBandDecimator per channel), the decimated samples of the last block are kept.
+// Their spectrum has the same bins as the one of the whole block up to the lower nyquist frequency, so the low band is
+// analysed with the same resolution (not a finer one) by a much smaller fft.
+class TimeDomainDopplerSpeedCalculator : public DopplerSpeedCalculator {
+
+public:
+    TimeDomainDopplerSpeedCalculator(float inputSampleRate);
+    ~TimeDomainDopplerSpeedCalculator();
+
+    string getIdentifier() const;
+    string getName() const;
+    string getDescription() const;
+
+    InputDomain getInputDomain() const;
+
+    ParameterList getParameterDescriptors() const;
+
+    bool initialise(size_t channels, size_t stepSize, size_t blockSize);
+
+    void reset();
+
+    FeatureSet process(const float *const *inputBuffers,
+                       Vamp::RealTime timestamp);
+
+private:
+    // decimates the samples of the channel which are new in this block, shifts them into m_decimated and writes the
+    // windowed decimated block to m_fftInput, returns the number of decimated samples shifted in
+    size_t decimate(size_t channel, const float *input, size_t samples);
+
+    // starts the decimation again with zeros before the next block
+    void restartDecimation();
+
+    size_t m_channels;
+    size_t m_decimation;
+    size_t m_windowSize;
+    size_t m_transformSize;
+
+    // number of complex values of the spectrum which are passed on, the ones above are cut off by the lowpass
+    size_t m_spectrumSize;
+
+    // the block is timestamped at its start, the spectrum at the center of the block like hosts do it
+    Vamp::RealTime m_centerOffset;
+
+    // samples of each block which weren't part of the block before (at most the whole block), with a gap between the
+    // blocks, every block is decimated on its own
+    size_t m_newSamples;
+    bool m_gapBetweenBlocks;
+
+    // samples fed to the decimators and decimated samples returned by them since the last reset, which give the
+    // position of the window over the decimated samples in the block
+    size_t m_decimatorInput;
+    size_t m_decimatorOutput;
+
+    // decimated samples at the end of the window which were flushed out of the decimators, i.e. aren't in m_decimated
+    size_t m_flushed;
+
+    // periodic hann window of m_windowSize values (the decimated block), which also makes up for the fewer samples
+    std::vector<double> m_window;
+
+    // the decimator of each channel, the last m_windowSize decimated samples of each channel
+    // and the decimated (or flushed) samples of the current block
+    std::vector<HalfBandDecimator> m_decimators;
+    std::vector<float> m_decimated;
+    std::vector<float> m_decimatorOutputs;
+
+    // plan of the real fft of m_transformSize values
+    std::unique_ptr<Vamp::FFTReal> m_fft;
+
+    // scratch buffers: the windowed (and decimated) block followed by zeros, the complex result as doubles
+    // and the complex results of all channels as floats (m_transformSize + 2 values per channel)
+    std::vector<double> m_fftInput;
+    std::vector<double> m_fftOutput;
+    std::vector<float> m_spectra;
+    std::vector<const float *> m_spectrumPointers;
+};
+
+#endif /* TimeDomainDopplerSpeedCalculator_hpp */
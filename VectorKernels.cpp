@@ -0,0 +1,468 @@
+//
+//  VectorKernels.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "VectorKernels.hpp"
+
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// coefficients of the series 2 / ln(2) * (t + t^3 / 3 + t^5 / 5 + t^7 / 7)
+#define LOG2_C1 2.8853900817779268f
+#define LOG2_C3 0.9617966939259756f
+#define LOG2_C5 0.5770780163555854f
+#define LOG2_C7 0.4121985831111324f
+#define LOG10_2 0.3010299956639812f
+#define SQRT_2 1.4142135623730951f
+
+// number of partial results of peakAndSumOfSquares, value i goes to lane i % STATISTICS_LANES
+#define STATISTICS_LANES 8
+
+namespace {
+
+    struct Implementation {
+        const char *name;
+        void (*magnitudes)(const float *, float *, size_t);
+        void (*squaredMagnitudes)(const float *, float *, size_t);
+        void (*decibels)(const float *, float *, size_t, float, float);
+        void (*multiplyAdd)(const float *, float *, size_t, float);
+        void (*squareRoots)(const float *, float *, size_t);
+        void (*peakAndSumOfSquares)(const float *, size_t, float &, float &);
+        void (*chunkPeaksAndWeightedSums)(const float *, size_t, const float *, float *, float *);
+    };
+
+    //////// scalar implementation, also used for the remainders of the vectorized loops
+
+    void magnitudesScalar(const float *complexValues, float *output, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            float re = complexValues[2*i];
+            float im = complexValues[2*i + 1];
+            output[i] = std::sqrt(re * re + im * im);
+        }
+    }
+
+    void squaredMagnitudesScalar(const float *complexValues, float *output, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            float re = complexValues[2*i];
+            float im = complexValues[2*i + 1];
+            output[i] = re * re + im * im;
+        }
+    }
+
+    void decibelsScalar(const float *input, float *output, size_t n, float gain, float factor) {
+        float scale = factor * LOG10_2;
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = scale * VectorKernels::fastLog2(gain * input[i]);
+        }
+    }
+
+    void multiplyAddScalar(const float *input, float *output, size_t n, float factor) {
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = output[i] + factor * input[i];
+        }
+    }
+
+    void squareRootsScalar(const float *input, float *output, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            output[i] = std::sqrt(input[i]);
+        }
+    }
+
+    // accumulates the values into the lanes, input must start at a multiple of STATISTICS_LANES
+    void statisticsLanesScalar(const float *input, size_t n, float *peaks, float *sums) {
+        for (size_t i = 0; i < n; ++i) {
+            float value = std::fabs(input[i]);
+            size_t lane = i % STATISTICS_LANES;
+            peaks[lane] = value > peaks[lane] ? value : peaks[lane];
+            sums[lane] = sums[lane] + value * value;
+        }
+    }
+
+    void combineStatisticsLanes(const float *peaks, const float *sums, float & peak, float & sumOfSquares) {
+        peak = 0;
+        sumOfSquares = 0;
+        for (size_t lane = 0; lane < STATISTICS_LANES; ++lane) {
+            peak = peaks[lane] > peak ? peaks[lane] : peak;
+            sumOfSquares = sumOfSquares + sums[lane];
+        }
+    }
+
+    void peakAndSumOfSquaresScalar(const float *input, size_t n, float & peak, float & sumOfSquares) {
+        float peaks[STATISTICS_LANES] = {0};
+        float sums[STATISTICS_LANES] = {0};
+        statisticsLanesScalar(input, n, peaks, sums);
+        combineStatisticsLanes(peaks, sums, peak, sumOfSquares);
+    }
+
+    // the products of the values i and i + 8 of a chunk are added first, then the halves of these 8 sums are
+    // added until one is left (the order in which the vectorized implementations reduce their registers)
+    void chunkPeaksAndWeightedSumsScalar(const float *input, size_t chunks, const float *weights, float *peaks, float *sums) {
+        for (size_t c = 0; c < chunks; ++c) {
+            const float *chunk = input + c * VECTOR_KERNELS_CHUNK_LENGTH;
+            float peak[8], sum[8];
+            for (size_t l = 0; l < 8; ++l) {
+                float a = std::fabs(chunk[l]);
+                float b = std::fabs(chunk[l + 8]);
+                peak[l] = b > a ? b : a;
+                sum[l] = a * weights[l] + b * weights[l + 8];
+            }
+            for (size_t width = 4; width > 0; width /= 2) {
+                for (size_t l = 0; l < width; ++l) {
+                    peak[l] = peak[l + width] > peak[l] ? peak[l + width] : peak[l];
+                    sum[l] = sum[l] + sum[l + width];
+                }
+            }
+            peaks[c] = peak[0];
+            sums[c] = sum[0];
+        }
+    }
+
+#ifdef VECTOR_KERNELS_X86
+
+    //////// SSE2 implementation
+
+    __attribute__((target("sse2")))
+    inline __m128 log2Sse2(__m128 x) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        // zero, negative and nan values become +0, which has the smallest exponent like the denormals
+        x = _mm_max_ps(x, _mm_setzero_ps());
+        __m128i bits = _mm_castps_si128(x);
+        __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+        __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+        // move the mantissa to [sqrt(0.5), sqrt(2))
+        __m128 large = _mm_cmpge_ps(mantissa, _mm_set1_ps(SQRT_2));
+        mantissa = _mm_or_ps(_mm_andnot_ps(large, mantissa), _mm_and_ps(large, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))));
+        __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_and_ps(large, one));
+
+        __m128 t = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 p = _mm_set1_ps(LOG2_C7);
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(LOG2_C5));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(LOG2_C3));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(LOG2_C1));
+        return _mm_add_ps(e, _mm_mul_ps(t, p));
+    }
+
+    // sums up the squares of pairs of neighbouring values in a and b
+    __attribute__((target("sse2")))
+    inline __m128 squaredMagnitudesSse2(const float *complexValues) {
+        __m128 a = _mm_loadu_ps(complexValues);
+        __m128 b = _mm_loadu_ps(complexValues + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        return _mm_add_ps(re, im);
+    }
+
+    __attribute__((target("sse2")))
+    void magnitudesSse2(const float *complexValues, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(output + i, _mm_sqrt_ps(squaredMagnitudesSse2(complexValues + 2*i)));
+        }
+        magnitudesScalar(complexValues + 2*i, output + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void squaredMagnitudesSse2(const float *complexValues, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(output + i, squaredMagnitudesSse2(complexValues + 2*i));
+        }
+        squaredMagnitudesScalar(complexValues + 2*i, output + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void decibelsSse2(const float *input, float *output, size_t n, float gain, float factor) {
+        __m128 g = _mm_set1_ps(gain);
+        __m128 scale = _mm_set1_ps(factor * LOG10_2);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128 x = _mm_mul_ps(g, _mm_loadu_ps(input + i));
+            _mm_storeu_ps(output + i, _mm_mul_ps(scale, log2Sse2(x)));
+        }
+        decibelsScalar(input + i, output + i, n - i, gain, factor);
+    }
+
+    __attribute__((target("sse2")))
+    void multiplyAddSse2(const float *input, float *output, size_t n, float factor) {
+        __m128 f = _mm_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(f, _mm_loadu_ps(input + i))));
+        }
+        multiplyAddScalar(input + i, output + i, n - i, factor);
+    }
+
+    __attribute__((target("sse2")))
+    void squareRootsSse2(const float *input, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(output + i, _mm_sqrt_ps(_mm_loadu_ps(input + i)));
+        }
+        squareRootsScalar(input + i, output + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void peakAndSumOfSquaresSse2(const float *input, size_t n, float & peak, float & sumOfSquares) {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 peaks0 = _mm_setzero_ps(), peaks1 = _mm_setzero_ps();
+        __m128 sums0 = _mm_setzero_ps(), sums1 = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + STATISTICS_LANES <= n; i += STATISTICS_LANES) {
+            __m128 a = _mm_and_ps(absMask, _mm_loadu_ps(input + i));
+            __m128 b = _mm_and_ps(absMask, _mm_loadu_ps(input + i + 4));
+            peaks0 = _mm_max_ps(a, peaks0);
+            peaks1 = _mm_max_ps(b, peaks1);
+            sums0 = _mm_add_ps(sums0, _mm_mul_ps(a, a));
+            sums1 = _mm_add_ps(sums1, _mm_mul_ps(b, b));
+        }
+        float peaks[STATISTICS_LANES], sums[STATISTICS_LANES];
+        _mm_storeu_ps(peaks, peaks0);
+        _mm_storeu_ps(peaks + 4, peaks1);
+        _mm_storeu_ps(sums, sums0);
+        _mm_storeu_ps(sums + 4, sums1);
+        statisticsLanesScalar(input + i, n - i, peaks, sums);
+        combineStatisticsLanes(peaks, sums, peak, sumOfSquares);
+    }
+
+    // reduces the 4 lanes of the peaks and sums to one value each, the higher half is added to the lower one
+    __attribute__((target("sse2")))
+    inline void reduceChunkSse2(__m128 peak, __m128 sum, float *peakOutput, float *sumOutput) {
+        peak = _mm_max_ps(_mm_movehl_ps(peak, peak), peak);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        peak = _mm_max_ss(_mm_shuffle_ps(peak, peak, 1), peak);
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        _mm_store_ss(peakOutput, peak);
+        _mm_store_ss(sumOutput, sum);
+    }
+
+    __attribute__((target("sse2")))
+    void chunkPeaksAndWeightedSumsSse2(const float *input, size_t chunks, const float *weights, float *peaks, float *sums) {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 w0 = _mm_loadu_ps(weights), w1 = _mm_loadu_ps(weights + 4);
+        __m128 w2 = _mm_loadu_ps(weights + 8), w3 = _mm_loadu_ps(weights + 12);
+        for (size_t c = 0; c < chunks; ++c) {
+            const float *chunk = input + c * VECTOR_KERNELS_CHUNK_LENGTH;
+            __m128 a0 = _mm_and_ps(absMask, _mm_loadu_ps(chunk));
+            __m128 a1 = _mm_and_ps(absMask, _mm_loadu_ps(chunk + 4));
+            __m128 a2 = _mm_and_ps(absMask, _mm_loadu_ps(chunk + 8));
+            __m128 a3 = _mm_and_ps(absMask, _mm_loadu_ps(chunk + 12));
+            __m128 peakLow = _mm_max_ps(a2, a0);
+            __m128 peakHigh = _mm_max_ps(a3, a1);
+            __m128 sumLow = _mm_add_ps(_mm_mul_ps(a0, w0), _mm_mul_ps(a2, w2));
+            __m128 sumHigh = _mm_add_ps(_mm_mul_ps(a1, w1), _mm_mul_ps(a3, w3));
+            reduceChunkSse2(_mm_max_ps(peakHigh, peakLow), _mm_add_ps(sumLow, sumHigh), peaks + c, sums + c);
+        }
+    }
+
+    //////// AVX2 implementation (without FMA, so that the results equal the ones of the other implementations)
+
+    __attribute__((target("avx2")))
+    inline __m256 log2Avx2(__m256 x) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        // zero, negative and nan values become +0, which has the smallest exponent like the denormals
+        x = _mm256_max_ps(x, _mm256_setzero_ps());
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+        __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+        // move the mantissa to [sqrt(0.5), sqrt(2))
+        __m256 large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(SQRT_2), _CMP_GE_OQ);
+        mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), large);
+        __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_and_ps(large, one));
+
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 p = _mm256_set1_ps(LOG2_C7);
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C5));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C3));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(LOG2_C1));
+        return _mm256_add_ps(e, _mm256_mul_ps(t, p));
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256 squaredMagnitudesAvx2(const float *complexValues) {
+        __m256 a = _mm256_loadu_ps(complexValues);
+        __m256 b = _mm256_loadu_ps(complexValues + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+        // the shuffles work within 128 bit lanes, so the order of the 64 bit blocks has to be fixed afterwards
+        __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 sum = _mm256_add_ps(re, im);
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    __attribute__((target("avx2")))
+    void magnitudesAvx2(const float *complexValues, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(output + i, _mm256_sqrt_ps(squaredMagnitudesAvx2(complexValues + 2*i)));
+        }
+        magnitudesScalar(complexValues + 2*i, output + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    void squaredMagnitudesAvx2(const float *complexValues, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(output + i, squaredMagnitudesAvx2(complexValues + 2*i));
+        }
+        squaredMagnitudesScalar(complexValues + 2*i, output + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    void decibelsAvx2(const float *input, float *output, size_t n, float gain, float factor) {
+        __m256 g = _mm256_set1_ps(gain);
+        __m256 scale = _mm256_set1_ps(factor * LOG10_2);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 x = _mm256_mul_ps(g, _mm256_loadu_ps(input + i));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(scale, log2Avx2(x)));
+        }
+        decibelsScalar(input + i, output + i, n - i, gain, factor);
+    }
+
+    __attribute__((target("avx2")))
+    void multiplyAddAvx2(const float *input, float *output, size_t n, float factor) {
+        __m256 f = _mm256_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_loadu_ps(output + i), _mm256_mul_ps(f, _mm256_loadu_ps(input + i))));
+        }
+        multiplyAddScalar(input + i, output + i, n - i, factor);
+    }
+
+    __attribute__((target("avx2")))
+    void squareRootsAvx2(const float *input, float *output, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(output + i, _mm256_sqrt_ps(_mm256_loadu_ps(input + i)));
+        }
+        squareRootsScalar(input + i, output + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    void peakAndSumOfSquaresAvx2(const float *input, size_t n, float & peak, float & sumOfSquares) {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 peaks0 = _mm256_setzero_ps();
+        __m256 sums0 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + STATISTICS_LANES <= n; i += STATISTICS_LANES) {
+            __m256 a = _mm256_and_ps(absMask, _mm256_loadu_ps(input + i));
+            peaks0 = _mm256_max_ps(a, peaks0);
+            sums0 = _mm256_add_ps(sums0, _mm256_mul_ps(a, a));
+        }
+        float peaks[STATISTICS_LANES], sums[STATISTICS_LANES];
+        _mm256_storeu_ps(peaks, peaks0);
+        _mm256_storeu_ps(sums, sums0);
+        statisticsLanesScalar(input + i, n - i, peaks, sums);
+        combineStatisticsLanes(peaks, sums, peak, sumOfSquares);
+    }
+
+    __attribute__((target("avx2")))
+    void chunkPeaksAndWeightedSumsAvx2(const float *input, size_t chunks, const float *weights, float *peaks, float *sums) {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 w0 = _mm256_loadu_ps(weights), w1 = _mm256_loadu_ps(weights + 8);
+        for (size_t c = 0; c < chunks; ++c) {
+            const float *chunk = input + c * VECTOR_KERNELS_CHUNK_LENGTH;
+            __m256 a = _mm256_and_ps(absMask, _mm256_loadu_ps(chunk));
+            __m256 b = _mm256_and_ps(absMask, _mm256_loadu_ps(chunk + 8));
+            __m256 peak = _mm256_max_ps(b, a);
+            __m256 sum = _mm256_add_ps(_mm256_mul_ps(a, w0), _mm256_mul_ps(b, w1));
+            reduceChunkSse2(_mm_max_ps(_mm256_extractf128_ps(peak, 1), _mm256_castps256_ps128(peak)),
+                            _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)), peaks + c, sums + c);
+        }
+    }
+
+#endif
+
+    Implementation selectImplementation() {
+#ifdef VECTOR_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Implementation{"avx2", magnitudesAvx2, squaredMagnitudesAvx2, decibelsAvx2, multiplyAddAvx2, squareRootsAvx2, peakAndSumOfSquaresAvx2,
+                chunkPeaksAndWeightedSumsAvx2};
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return Implementation{"sse2", magnitudesSse2, squaredMagnitudesSse2, decibelsSse2, multiplyAddSse2, squareRootsSse2, peakAndSumOfSquaresSse2,
+                chunkPeaksAndWeightedSumsSse2};
+        }
+#endif
+        return Implementation{"scalar", magnitudesScalar, squaredMagnitudesScalar, decibelsScalar, multiplyAddScalar, squareRootsScalar, peakAndSumOfSquaresScalar,
+            chunkPeaksAndWeightedSumsScalar};
+    }
+
+    const Implementation & selected() {
+        static const Implementation implementation = selectImplementation();
+        return implementation;
+    }
+}
+
+float VectorKernels::fastLog2(float x) {
+    // zero, negative and nan values become +0 like in the vectorized versions (see log2Sse2)
+    x = x > 0 ? x : 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int32_t exponent = (int32_t) (bits >> 23) - 127;
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+
+    // move the mantissa to [sqrt(0.5), sqrt(2))
+    float e = (float) exponent;
+    if (mantissa >= SQRT_2) {
+        mantissa = mantissa * 0.5f;
+        e = e + 1.0f;
+    }
+
+    float t = (mantissa - 1.0f) / (mantissa + 1.0f);
+    float t2 = t * t;
+    float p = LOG2_C7;
+    p = p * t2 + LOG2_C5;
+    p = p * t2 + LOG2_C3;
+    p = p * t2 + LOG2_C1;
+    return e + t * p;
+}
+
+void VectorKernels::magnitudes(const float *complexValues, float *output, size_t n) {
+    selected().magnitudes(complexValues, output, n);
+}
+
+void VectorKernels::squaredMagnitudes(const float *complexValues, float *output, size_t n) {
+    selected().squaredMagnitudes(complexValues, output, n);
+}
+
+void VectorKernels::decibels(const float *input, float *output, size_t n, float gain, float factor) {
+    selected().decibels(input, output, n, gain, factor);
+}
+
+void VectorKernels::squareRoots(const float *input, float *output, size_t n) {
+    selected().squareRoots(input, output, n);
+}
+
+void VectorKernels::multiplyAdd(const float *input, float *output, size_t n, float factor) {
+    selected().multiplyAdd(input, output, n, factor);
+}
+
+void VectorKernels::peakAndSumOfSquares(const float *input, size_t n, float & peak, float & sumOfSquares) {
+    selected().peakAndSumOfSquares(input, n, peak, sumOfSquares);
+}
+
+void VectorKernels::chunkPeaksAndWeightedSums(const float *input, size_t chunks, const float *weights, float *peaks, float *sums) {
+    selected().chunkPeaksAndWeightedSums(input, chunks, weights, peaks, sums);
+}
+
+const char *VectorKernels::implementation() {
+    return selected().name;
+}
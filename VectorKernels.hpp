@@ -0,0 +1,56 @@
+//
+//  VectorKernels.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef VectorKernels_hpp
+#define VectorKernels_hpp
+
+#include <stdio.h>
+
+// number of values in a chunk of chunkPeaksAndWeightedSums
+# define VECTOR_KERNELS_CHUNK_LENGTH 16
+
+// Loops over whole spectra which are vectorized with SSE2 or AVX2 if the processor supports it.
+// The implementation is selected once at runtime, all implementations return bit-identical results
+// (they use the same operations in the same order, only on more values at once).
+namespace VectorKernels {
+
+    // calculates the magnitudes of n complex values which are given as interleaved real and imaginary parts
+    void magnitudes(const float *complexValues, float *output, size_t n);
+
+    // calculates the squared magnitudes (re² + im²) of n complex values given as interleaved real and imaginary parts
+    void squaredMagnitudes(const float *complexValues, float *output, size_t n);
+
+    // calculates output[i] = factor * log10(gain * input[i]) for n non-negative values
+    // log10 is approximated by a polynomial (see fastLog2). The truncation error of the series is below 5e-8 in log2,
+    // so the result is dominated by float rounding (of the scale factor * log10(2) and of the result, which grows with
+    // the exponent). Measured over all normal values of gain * input[i], the absolute error of log10 is below 5e-6
+    // (1.1e-4 dB for factor 20), and below 1.7e-6 (3.6e-5 dB) for values from 1e-12 to 1e3. Zero, negative and
+    // denormal values yield factor * log10(2^-127) (about -765 dB for factor 20) instead of -inf or nan.
+    void decibels(const float *input, float *output, size_t n, float gain, float factor);
+
+    // calculates output[i] = sqrt(input[i]) for n non-negative values (input and output may be the same)
+    void squareRoots(const float *input, float *output, size_t n);
+
+    // calculates output[i] += factor * input[i] for n values (input and output must not overlap)
+    void multiplyAdd(const float *input, float *output, size_t n, float factor);
+
+    // calculates the maximum absolute value and the sum of the squares of n values in one pass over them
+    // the sum is accumulated in 8 interleaved partial sums, which are added up in the same order by all implementations
+    void peakAndSumOfSquares(const float *input, size_t n, float & peak, float & sumOfSquares);
+
+    // calculates the maximum absolute value and the sum of weights[i] * |x[i]| of each of the given number of chunks
+    // of VECTOR_KERNELS_CHUNK_LENGTH consecutive values, i.e. one output of each per chunk
+    void chunkPeaksAndWeightedSums(const float *input, size_t chunks, const float *weights, float *peaks, float *sums);
+
+    // approximates log2(x) for a positive, normal x; the mantissa is reduced to [sqrt(0.5), sqrt(2)) and
+    // log2 is evaluated by the first four terms of the series of 2 * atanh((m - 1) / (m + 1)) / ln(2)
+    // zero, negative, denormal and nan values yield about -127
+    float fastLog2(float x);
+
+    // name of the implementation selected for this processor ("avx2", "sse2" or "scalar")
+    const char *implementation();
+}
+
+#endif /* VectorKernels_hpp */
@@ -0,0 +1,84 @@
+//
+//  WorkerPool.cpp
+//  wunderwelt-vamp-plugin
+//
+
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool():
+    generation(0),
+    stopping(false),
+    context(nullptr),
+    call(nullptr),
+    jobCount(0),
+    nextJob(0),
+    busy(0) {
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(size_t threadCount) {
+    stop();
+    for (size_t i = 0; i < threadCount; ++i) {
+        this->threads.emplace_back(&WorkerPool::wait, this, this->generation);
+    }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto & thread : this->threads) {
+        thread.join();
+    }
+    this->threads.clear();
+    this->stopping = false;
+}
+
+void WorkerPool::runJobs(size_t count, void *context, void (*call)(void *, size_t)) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->context = context;
+        this->call = call;
+        this->jobCount = count;
+        this->nextJob = 0;
+        this->busy = this->threads.size();
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [this] { return this->busy == 0; });
+}
+
+void WorkerPool::work() {
+    for (size_t index = this->nextJob++; index < this->jobCount; index = this->nextJob++) {
+        this->call(this->context, index);
+    }
+}
+
+void WorkerPool::wait(size_t seen) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this, seen] { return this->stopping || this->generation != seen; });
+            if (this->stopping) {
+                return;
+            }
+            seen = this->generation;
+        }
+
+        work();
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (--this->busy == 0) {
+            this->done.notify_one();
+        }
+    }
+}
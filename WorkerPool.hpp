@@ -0,0 +1,68 @@
+//
+//  WorkerPool.hpp
+//  wunderwelt-vamp-plugin
+//
+
+#ifndef WorkerPool_hpp
+#define WorkerPool_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// WorkerPool runs a number of independent jobs (e.g. the analysis of each channel) on persistent threads, so no thread
+// is started per step. The calling thread works on the jobs too and run returns once all of them are done.
+class WorkerPool {
+
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // starts the given number of threads in addition to the calling one, threads started before are stopped
+    void start(size_t threadCount);
+
+    // stops all threads, afterwards run does all jobs on the calling thread
+    void stop();
+
+    // calls job(i) for every i below count, distributed over the threads, and waits until all calls returned
+    template<class Job> void run(size_t count, Job & job) {
+        runJobs(count, &job, [](void *context, size_t index) {
+            (*static_cast<Job *>(context))(index);
+        });
+    }
+
+    // number of threads in addition to the calling one
+    size_t size() const {
+        return this->threads.size();
+    }
+
+private:
+    void runJobs(size_t count, void *context, void (*call)(void *, size_t));
+
+    // does jobs until there are none left
+    void work();
+
+    // main function of the threads, seen is the generation of the last run before the thread was started
+    void wait(size_t seen);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // incremented for every run, so the threads know when there are new jobs
+    size_t generation;
+    bool stopping;
+
+    // the jobs of the current run and the number of threads which are still working on them
+    void *context;
+    void (*call)(void *, size_t);
+    size_t jobCount;
+    std::atomic<size_t> nextJob;
+    size_t busy;
+};
+
+#endif /* WorkerPool_hpp */
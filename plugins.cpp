@@ -5,6 +5,7 @@
 
 #include "AmplitudeFollower.hpp"
 #include "DopplerSpeedCalculator.hpp"
+#include "TimeDomainDopplerSpeedCalculator.hpp"
 
 class DopplerAdapter : public Vamp::PluginAdapterBase
 {
@@ -20,6 +21,20 @@ protected:
     }
 };
 
+class TimeDomainDopplerAdapter : public Vamp::PluginAdapterBase
+{
+public:
+    TimeDomainDopplerAdapter():
+        PluginAdapterBase() { }
+
+    virtual ~TimeDomainDopplerAdapter() { }
+
+protected:
+    Vamp::Plugin *createPlugin(float inputSampleRate) {
+        return new TimeDomainDopplerSpeedCalculator(inputSampleRate);
+    }
+};
+
 class AmplitudeAdapter : public Vamp::PluginAdapterBase
 {
 public:
@@ -36,6 +51,7 @@ protected:
 
 static AmplitudeAdapter amplitudeFollower;
 static DopplerAdapter speedCalculator;
+static TimeDomainDopplerAdapter timeDomainSpeedCalculator;
 
 const VampPluginDescriptor *
 vampGetPluginDescriptor(unsigned int version, unsigned int index)
@@ -50,6 +66,7 @@ vampGetPluginDescriptor(unsigned int version, unsigned int index)
     switch (index) {
         case  0: return speedCalculator.getDescriptor();
         case  1: return amplitudeFollower.getDescriptor();
+        case  2: return timeDomainSpeedCalculator.getDescriptor();
         default: return 0;
     }
 }